@@ -22,7 +22,13 @@ void CLI::register_default_commands() {
             {"-b", "--builddir", "Build directory path", true, "build"},
             {"-p", "--prefix", "Installation prefix", true, "/usr/local"},
             {"", "--buildtype", "Build type (debug/release/minsize)", true, "debug"},
-            {"", "--backend", "Build backend (ninja/make)", true, "ninja"}
+            {"", "--backend", "Build backend (ninja/make)", true, "ninja"},
+            {"", "--unity", "Enable unity builds for every target", false, ""},
+            {"", "--dev-shared", "Build libraries as shared objects (non-release)", false, ""},
+            {"", "--no-cache", "Do not use the build cache", false, ""},
+            {"", "--remote-cache", "Shared http cache behind the local one (default: $IRIS_REMOTE_CACHE)", true, ""},
+            {"", "--reproducible", "Pin __DATE__/__TIME__ with SOURCE_DATE_EPOCH", false, ""},
+            {"", "--compdb", "compile_commands.json (full/sharded/none)", true, "full"}
         },
         {"source_dir"},
         commands::cmd_setup
@@ -38,7 +44,9 @@ void CLI::register_default_commands() {
             {"-c", "--clean", "Clean before building", false, ""},
             {"", "--target", "Specific target to build", true, ""},
             {"", "--builddir", "Build directory path", true, "build"},
-            {"", "--builddir", "Build directory path", true, "build"}
+            {"", "--builddir", "Build directory path", true, "build"},
+            {"", "--check-determinism", "Rebuild compiles and compare their objects", false, ""},
+            {"", "--sample", "Compiles to check, 0 for all", true, "20"}
         },
         {},
         commands::cmd_build
@@ -97,19 +105,45 @@ void CLI::register_default_commands() {
     });
 
 
-    // ttest command
+    // test command
     add_command({
         "test",
         "Run project tests",
         {
-            {"-v", "--verbose", "Verbose test output", false, ""},
+            {"-v", "--verbose", "Print the output of every test", false, ""},
+            {"-j", "--jobs", "Tests to run at once", true, ""},
             {"", "--filter", "Test name filter", true, ""},
-            {"", "--timeout", "Test timeout in seconds", true, "60"}
+            {"", "--timeout", "Test timeout in seconds, 0 for none", true, "60"},
+            {"", "--builddir", "Build directory path", true, "build"},
+            {"", "--junit", "Write a JUnit XML report to this file", true, ""},
+            {"", "--json", "Write a JSON report to this file", true, ""},
+            {"", "--no-cache-tests", "Run tests whose passing result is cached", false, ""},
+            {"", "--shard", "Run shard i of N (i/N), balanced by test durations", true, ""},
+            {"", "--durations", "Duration files or JSON reports to balance shards with, comma separated", true, ""}
         },
         {},
         commands::cmd_test
     });
 
+    // bench command
+    add_command({
+        "bench",
+        "Run benchmark targets and compare with a baseline",
+        {
+            {"", "--filter", "Benchmark name filter", true, ""},
+            {"-r", "--repetitions", "Measured runs per benchmark", true, "10"},
+            {"", "--warmup", "Unmeasured runs before those", true, "1"},
+            {"", "--cpu", "CPU to pin benchmarks to, -1 for none", true, ""},
+            {"", "--baseline", "Baseline to compare with", true, ""},
+            {"", "--save-baseline", "Store the results as the new baseline", false, ""},
+            {"", "--threshold", "Smallest change in percent that counts", true, "5"},
+            {"", "--builddir", "Build directory path", true, "build"},
+            {"", "--json", "Write the results to this file", true, ""}
+        },
+        {},
+        commands::cmd_bench
+    });
+
     // info command
     add_command({
         "info",
@@ -135,6 +169,71 @@ void CLI::register_default_commands() {
         commands::cmd_graph
     });
 
+    // cache command
+    add_command({
+        "cache",
+        "Inspect, trim, share or serve the build cache (stats/gc/export/import/push/serve)",
+        {
+            {"", "--dir", "Cache directory (default: $IRIS_CACHE_DIR or .iris-cache)", true, ""},
+            {"", "--max-size", "Size to trim the cache to, e.g. 2G", true, ""},
+            {"", "--max-age", "Evict entries unused for longer, e.g. 30d", true, ""},
+            {"", "--since", "Export entries used since a stamp file's time or within an age, e.g. 2h", true, ""},
+            {"", "--remote", "Remote cache to push to (default: $IRIS_REMOTE_CACHE)", true, ""},
+            {"", "--bind", "Address serve listens on", true, "127.0.0.1"},
+            {"", "--port", "Port serve listens on", true, "8080"}
+        },
+        {"action", "file"},
+        commands::cmd_cache
+    });
+
+    // collate-modules command, run by ninja between scanning and compiling
+    add_command({
+        "collate-modules",
+        "Collate C++ module scan results into a dyndep file",
+        {
+            {"", "--units", "Scanned units list", true, "modules.units"},
+            {"-o", "--output", "Dyndep file to write", true, "modules.dd"},
+            {"", "--format", "Module map format (gcc/clang)", true, "gcc"}
+        },
+        {},
+        commands::cmd_collate_modules,
+        true
+    });
+
+    // compile command, wraps compiler invocations for early cutoff
+    add_command({
+        "compile",
+        "Run a compile command, keeping the output if it did not change",
+        {
+            {"", "--cache", "Build cache directory", true, ""},
+            {"", "--root", "Source root, for checkout independent cache keys", true, ""},
+            {"", "--remote", "Remote cache url", true, ""}
+        },
+        {"output", "-- command..."},
+        commands::cmd_compile,
+        true
+    });
+
+    // compile-batch command, several small sources in one compiler process
+    add_command({
+        "compile-batch",
+        "Compile several sources with one compiler invocation",
+        {},
+        {"batch", "source=object...", "-- command..."},
+        commands::cmd_compile_batch,
+        true
+    });
+
+    // interface command, records the exported symbols of a shared library
+    add_command({
+        "interface",
+        "Write the exported interface of a shared library",
+        {},
+        {"library", "output"},
+        commands::cmd_interface,
+        true
+    });
+
     // global options
     add_global_option({"-h", "--help", "Show help message", false, ""});
     add_global_option({"-V", "--version", "Show version", false, ""});
@@ -183,6 +282,7 @@ int CLI::run(int argc, char* argv[]) {
     // check for command specific help
     for (int i = 2; i < argc; i++) {
         std::string arg = argv[i];
+        if (arg == "--") break;
         if (arg == "-h" || arg == "--help") {
             print_command_help(cmd_it->name);
             return 0;
@@ -217,7 +317,14 @@ CLI::parse_args(int argc, char* argv[], const Command* cmd) {
     for (int i = 2; i < argc; i++) {
         std::string arg = argv[i];
 
-        if (arg[0] == '-') {
+        // everything after "--" is passed through untouched, the marker is
+        // kept so handlers can tell both halves apart
+        if (arg == "--") {
+            positional.insert(positional.end(), argv + i, argv + argc);
+            break;
+        }
+
+        if (arg[0] == '-' && arg != "-") {
             // find matching option
             const Option* matched = nullptr;
             for (const auto& opt : cmd->options) {
@@ -281,10 +388,12 @@ void CLI::print_help() const {
     
     size_t max_len = 0;
     for (const auto& cmd : m_commands) {
+        if (cmd.hidden) continue;
         max_len = std::max(max_len, cmd.name.length());
     }
 
     for (const auto& cmd : m_commands) {
+        if (cmd.hidden) continue;
         std::cout << "    ";
         Terminal::print_styled(cmd.name, Color::Green);
         std::cout << std::string(max_len - cmd.name.length() + 4, ' ');
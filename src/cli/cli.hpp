@@ -23,6 +23,7 @@ namespace iris::cli {
         std::vector<std::string> positional_args;
         std::function<int(const std::map<std::string, std::string>&,
                           const std::vector<std::string>&)> handler;
+        bool hidden = false;  // internal commands invoked by generated build files
     };
 
     class CLI {
@@ -5,13 +5,28 @@
 #include "../lang/interpreter.hpp"
 #include "../ui/terminal.hpp"
 #include "../core/graph.hpp"
+#include "../core/modules.hpp"
+#include "../core/compile.hpp"
+#include "../core/interface.hpp"
+#include "../core/cache.hpp"
+#include "../core/testing.hpp"
+#include "../core/bench.hpp"
 #include "../ui/progress.hpp"
 #include "../util/fs.hpp"
+#include "../util/http.hpp"
 
 #include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <cctype>
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <thread>
 
 namespace fs = std::filesystem;
 
@@ -50,6 +65,45 @@ int cmd_setup(const std::map<std::string, std::string>& options,
         interpreter.set_variable("prefix", options.at("prefix"));
         
         auto config = interpreter.execute(ast);
+        config.build_type = build_type;
+        config.unity = options.count("unity") && options.at("unity") == "true";
+        config.dev_shared = options.count("dev-shared") && options.at("dev-shared") == "true";
+        if (!(options.count("no-cache") && options.at("no-cache") == "true")) {
+            const char* env_cache = std::getenv("IRIS_CACHE_DIR");
+            std::string cache_dir = env_cache && *env_cache ? env_cache : source_dir + "/.iris-cache";
+            config.cache_dir = fs::absolute(cache_dir).lexically_normal().string();
+        }
+        config.source_root = fs::absolute(source_dir).lexically_normal().string();
+        if (config.source_root.size() > 1 && config.source_root.back() == '/') {
+            config.source_root.pop_back();
+        }
+
+        const char* env_remote = std::getenv("IRIS_REMOTE_CACHE");
+        std::string remote = options.count("remote-cache") ? options.at("remote-cache")
+                           : env_remote ? env_remote : "";
+        if (!remote.empty() && config.cache_dir.empty()) {
+            Terminal::warning("--remote-cache needs the local cache, ignoring it");
+        } else if (!remote.empty()) {
+            util::http::parse_url(remote);
+            config.remote_cache = remote;
+            Terminal::info("Remote cache", remote);
+        }
+
+        if (options.count("reproducible") && options.at("reproducible") == "true") {
+            const char* env_epoch = std::getenv("SOURCE_DATE_EPOCH");
+            std::string epoch = env_epoch && *env_epoch ? env_epoch : "0";
+            if (epoch.find_first_not_of("0123456789") != std::string::npos) {
+                throw std::runtime_error("SOURCE_DATE_EPOCH must be a number of seconds: " + epoch);
+            }
+            config.source_date_epoch = epoch;
+            Terminal::info("Source date", "SOURCE_DATE_EPOCH=" + epoch);
+        }
+
+        std::string compdb = options.count("compdb") ? options.at("compdb") : "full";
+        if (compdb != "full" && compdb != "sharded" && compdb != "none") {
+            throw std::runtime_error("Unknown --compdb mode: " + compdb);
+        }
+        config.compdb = compdb;
 
         // create build directory
         fs::create_directories(build_dir);
@@ -70,6 +124,67 @@ int cmd_setup(const std::map<std::string, std::string>& options,
     return 0;
 }
 
+// rebuilds compiles of a finished build and reports objects that came out
+// different, which never hit the cache
+static int check_determinism(core::Engine& engine, const std::string& target, int sample, int jobs) {
+    using namespace iris::ui;
+
+    auto results = engine.check_determinism(target, sample, jobs);
+    if (results.empty()) {
+        Terminal::warning("No cached compiles to check, run 'iris setup' again");
+        return 0;
+    }
+
+    auto join = [](const std::vector<std::string>& names) {
+        std::string text;
+        for (const auto& name : names) {
+            text += (text.empty() ? "" : ", ") + name;
+        }
+        return text;
+    };
+
+    int differing = 0;
+    int failed = 0;
+    int leaking = 0;
+    int dated = 0;
+    for (const auto& result : results) {
+        if (!result.rebuilt) {
+            failed++;
+            Terminal::warning(result.object + " failed to rebuild");
+            continue;
+        }
+        if (!result.identical) {
+            differing++;
+            Terminal::warning(result.object + " differs between builds");
+            if (!result.sections.empty()) {
+                std::cout << "    sections: " << join(result.sections) << "\n";
+            }
+        }
+        if (result.date_time && engine.config().source_date_epoch.empty()) {
+            dated++;
+            std::cout << "    " << result.object << " expands __DATE__ or __TIME__\n";
+        }
+        if (!result.leaks.empty()) {
+            leaking++;
+            std::cout << "    " << result.object << " embeds the checkout path in "
+                      << join(result.leaks) << "\n";
+        }
+    }
+
+    int count = static_cast<int>(results.size());
+    Terminal::info("Determinism", std::to_string(count - differing - failed) + " of " +
+                   std::to_string(count) + (count == 1 ? " object" : " objects") +
+                   " rebuilt identically");
+    if (dated > 0) {
+        Terminal::hint("'iris setup --reproducible' pins __DATE__ and __TIME__ via SOURCE_DATE_EPOCH");
+    }
+    if (leaking > 0) {
+        Terminal::hint("Absolute paths keep objects from being shared between checkouts, "
+                       "map them with -ffile-prefix-map");
+    }
+    return differing > 0 || failed > 0 ? 1 : 0;
+}
+
 int cmd_build(const std::map<std::string, std::string>& options,
               const std::vector<std::string>& positional) {
     using namespace iris::ui;
@@ -118,12 +233,35 @@ int cmd_build(const std::map<std::string, std::string>& options,
             Terminal::print_styled(" [", Color::Gray);
             std::cout << std::fixed << std::setprecision(2) << secs << "s";
             Terminal::print_styled("]\n", Color::Gray);
+
+            if (engine.cutoff_count() > 0) {
+                int count = engine.cutoff_count();
+                Terminal::info("Early cutoff", std::to_string(count) +
+                               (count == 1 ? " output" : " outputs") +
+                               " unchanged, dependent steps skipped");
+            }
+            if (engine.prefetch_count() > 0) {
+                int count = engine.prefetch_count();
+                Terminal::info("Remote cache", std::to_string(count) +
+                               (count == 1 ? " object" : " objects") + " fetched ahead of the build");
+            }
+            if (engine.upload_count() > 0) {
+                int count = engine.upload_count();
+                Terminal::info("Remote cache", std::to_string(count) +
+                               (count == 1 ? " new entry" : " new entries") + " uploaded");
+            }
         } else {
             Terminal::print_styled("  ✗ ", Color::Red, Style::Bold);
             std::cout << "Build failed\n";
             return result;
         }
 
+        if (options.count("check-determinism") && options.at("check-determinism") == "true") {
+            std::string sample = options.count("sample") ? options.at("sample") : "20";
+            return check_determinism(engine, target, sample.empty() ? 0 : std::stoi(sample),
+                                     jobs.empty() ? 0 : std::stoi(jobs));
+        }
+
     } catch (const std::exception& e) {
         Terminal::error("Build error: " + std::string(e.what()));
         return 1;
@@ -371,75 +509,454 @@ int cmd_run(const std::map<std::string, std::string>& options,
     return result;
 }
 
+// the last lines of a test log, enough to see why it failed
+static void print_log_tail(const std::string& path, size_t lines) {
+    std::string text = util::fs::read_file(path);
+    size_t begin = text.size();
+    size_t count = 0;
+    while (begin > 0 && count <= lines) {
+        begin = text.rfind('\n', begin - 1);
+        if (begin == std::string::npos) {
+            begin = 0;
+            break;
+        }
+        count++;
+    }
+    if (begin > 0) {
+        begin++;
+        std::cout << "      [... see " << path << " for the full output]\n";
+    }
+    std::istringstream in(text.substr(begin));
+    std::string line;
+    while (std::getline(in, line)) {
+        std::cout << "      " << line << "\n";
+    }
+}
+
 int cmd_test(const std::map<std::string, std::string>& options,
              const std::vector<std::string>& positional) {
     using namespace iris::ui;
 
-    Terminal::header("Running Tests");
-
+    std::string build_dir = options.count("builddir") && !options.at("builddir").empty() ? options.at("builddir") : "build";
     bool verbose = options.count("verbose") && options.at("verbose") == "true";
-    (void)verbose;
     std::string filter = options.count("filter") ? options.at("filter") : "";
-    int timeout = std::stoi(options.at("timeout"));
-    (void)timeout;
+    std::string junit = options.count("junit") ? options.at("junit") : "";
+    std::string json = options.count("json") ? options.at("json") : "";
+    bool use_cache = !(options.count("no-cache-tests") && options.at("no-cache-tests") == "true");
+    std::string shard = options.count("shard") ? options.at("shard") : "";
+    std::string durations_from = options.count("durations") ? options.at("durations") : "";
+    int timeout = 0;
+    int jobs = 0;
+    try {
+        timeout = std::stoi(options.at("timeout"));
+        jobs = options.count("jobs") && !options.at("jobs").empty() ? std::stoi(options.at("jobs")) : 0;
+    } catch (const std::exception&) {
+        Terminal::error("--timeout and --jobs take a number");
+        return 1;
+    }
+    if (jobs <= 0) {
+        jobs = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+
+    // --shard=i/N, counted from 1
+    int shard_index = 0, shard_count = 0;
+    if (!shard.empty()) {
+        size_t slash = shard.find('/');
+        try {
+            size_t used = 0;
+            shard_index = std::stoi(shard.substr(0, slash), &used);
+            shard_count = slash == std::string::npos || used != slash ? 0 : std::stoi(shard.substr(slash + 1));
+        } catch (const std::exception&) {
+            shard_count = 0;
+        }
+        if (shard_count < 1 || shard_index < 1 || shard_index > shard_count) {
+            Terminal::error("Invalid --shard '" + shard + "', expected i/N with 1 <= i <= N");
+            return 1;
+        }
+    }
 
     // build first
-    int build_result = cmd_build({}, {});
+    int build_result = cmd_build({{"builddir", build_dir}}, {});
     if (build_result != 0) {
         return build_result;
     }
 
-    // find and run tests
-    int passed = 0, failed = 0, skipped = 0;
+    Terminal::header("Running Tests");
 
-    // look for test executables
-    std::string test_dir = "build/tests";
-    if (!fs::exists(test_dir)) {
+    std::vector<core::TestCase> tests;
+    try {
+        tests = core::read_tests(build_dir);
+    } catch (const std::exception& e) {
+        Terminal::error(e.what());
+        Terminal::hint("Run 'iris setup' again to configure test targets");
+        return 1;
+    }
+
+    int skipped = 0;
+    if (!filter.empty()) {
+        auto unmatched = std::remove_if(tests.begin(), tests.end(), [&](const core::TestCase& test) {
+            return test.name.find(filter) == std::string::npos;
+        });
+        skipped = static_cast<int>(tests.end() - unmatched);
+        tests.erase(unmatched, tests.end());
+    }
+    if (tests.empty()) {
         Terminal::warning("No tests found");
-        Terminal::hint("Create a 'test' target in your iris.build file");
+        Terminal::hint("Add a 'test \"name\" do ... end' target to your iris.build file");
         return 0;
     }
 
-    for (const auto& entry : fs::directory_iterator(test_dir)) {
-        if (!fs::is_regular_file(entry)) continue;
+    // every machine computes the same split from the same durations. local
+    // history differs between machines, so without --durations every test
+    // weighs the same
+    double predicted = -1.0;            // seconds, negative without durations
+    size_t total_tests = tests.size();
+    if (shard_count > 0) {
+        std::map<std::string, double> durations;
+        if (durations_from.empty()) {
+            Terminal::warning("No --durations given, shards are split by test count");
+            Terminal::hint("Pass the JSON reports of the last run with --durations to balance them by time");
+        } else {
+            std::istringstream files(durations_from);
+            std::string file;
+            while (std::getline(files, file, ',')) {
+                if (!fs::exists(file)) {
+                    Terminal::warning(file + " not found, machines that have it split differently");
+                    continue;
+                }
+                try {
+                    for (const auto& [name, seconds] : core::read_duration_file(file)) {
+                        durations[name] = seconds;
+                    }
+                } catch (const std::exception& e) {
+                    Terminal::error(file + ": " + e.what());
+                    return 1;
+                }
+            }
+        }
+
+        auto shards = core::partition_tests(tests, durations, shard_count);
+        std::string key = core::partition_key(tests, durations);
+        const auto& mine = shards[shard_index - 1];
+        std::vector<core::TestCase> selected;
+        for (size_t index : mine.tests) {
+            selected.push_back(tests[index]);
+        }
+        tests = std::move(selected);
+        predicted = durations.empty() ? -1.0 : mine.predicted;
 
-        std::string test_name = entry.path().filename().string();
-        
-        if (!filter.empty() && test_name.find(filter) == std::string::npos) {
-            skipped++;
-            continue;
+        std::ostringstream line;
+        line << shard_index << "/" << shard_count << " runs " << tests.size() << " of " << total_tests << " tests, ";
+        if (predicted >= 0.0) {
+            line << "predicted " << std::fixed << std::setprecision(1) << predicted << "s, ";
+        }
+        line << "split " << key;
+        Terminal::info("Shard", line.str());
+        if (tests.empty()) {
+            return 0;
         }
+    }
 
+    core::TestRunner runner(build_dir);
+    runner.set_jobs(jobs);
+    runner.set_timeout(timeout);
+    runner.set_cache(use_cache);
+    runner.on_result([&](const core::TestResult& result) {
         std::cout << "  ";
-        Terminal::print_styled("TEST", Color::Blue, Style::Bold);
-        std::cout << "  " << test_name << " ... ";
+        switch (result.status) {
+            case core::TestStatus::Passed:
+                Terminal::print_styled("PASS   ", Color::Green, Style::Bold);
+                break;
+            case core::TestStatus::Failed:
+                Terminal::print_styled("FAIL   ", Color::Red, Style::Bold);
+                break;
+            case core::TestStatus::TimedOut:
+                Terminal::print_styled("TIMEOUT", Color::Red, Style::Bold);
+                break;
+            case core::TestStatus::Cached:
+                Terminal::print_styled("CACHED ", Color::Green);
+                break;
+        }
+        std::cout << " " << result.name;
+        if (result.status != core::TestStatus::Cached) {
+            std::cout << " (" << std::fixed << std::setprecision(2) << result.seconds << "s";
+            if (result.shards > 1) {
+                std::cout << " in " << result.shards << " shards";
+            }
+            std::cout << ")";
+        }
+        if (result.status == core::TestStatus::Failed) {
+            std::cout << ", exit code " << result.exit_code;
+        }
+        if (result.flaky) {
+            Terminal::print_styled(", flaky, not cached", Color::Yellow);
+        }
+        std::cout << "\n";
+        if (result.status == core::TestStatus::Failed || result.status == core::TestStatus::TimedOut ||
+            (verbose && result.status == core::TestStatus::Passed)) {
+            print_log_tail(build_dir + "/" + result.log, verbose ? SIZE_MAX : 40);
+        }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<core::TestResult> results;
+    try {
+        results = runner.run(tests);
+    } catch (const std::exception& e) {
+        Terminal::error(e.what());
+        return 130;
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-        int result = std::system(entry.path().string().c_str());
+    core::record_durations(build_dir, results);
 
-        if (result == 0) {
-            Terminal::print_styled("PASS\n", Color::Green, Style::Bold);
+    int passed = 0, failed = 0, cached = 0;
+    for (const auto& result : results) {
+        if (result.status == core::TestStatus::Passed) {
+            passed++;
+        } else if (result.status == core::TestStatus::Cached) {
             passed++;
+            cached++;
         } else {
-            Terminal::print_styled("FAIL\n", Color::Red, Style::Bold);
             failed++;
         }
     }
 
+    try {
+        core::Engine engine;
+        engine.load_from_build_dir(build_dir);
+        std::string suite = engine.config().project_name;
+        if (!junit.empty()) {
+            core::write_junit_report(junit, suite, results, build_dir);
+            Terminal::info("Report", junit);
+        }
+        if (!json.empty()) {
+            core::write_json_report(json, results);
+            Terminal::info("Report", json);
+        }
+    } catch (const std::exception& e) {
+        Terminal::error(e.what());
+        return 1;
+    }
+
     std::cout << "\n";
     Terminal::separator();
     std::cout << "  Results: ";
     Terminal::print_styled(std::to_string(passed) + " passed", Color::Green);
+    if (cached > 0) {
+        std::cout << " (" << cached << " cached)";
+    }
     std::cout << ", ";
     if (failed > 0) {
         Terminal::print_styled(std::to_string(failed) + " failed", Color::Red);
     } else {
         std::cout << "0 failed";
     }
-    std::cout << ", " << skipped << " skipped\n";
+    std::cout << ", " << skipped << " skipped in " << std::fixed << std::setprecision(2)
+              << secs << "s (" << jobs << " jobs)\n";
+    if (shard_count > 0) {
+        double actual = 0.0;
+        for (const auto& result : results) {
+            actual += result.seconds;
+        }
+        std::cout << "  Shard " << shard_index << "/" << shard_count << ": " << std::setprecision(1);
+        if (predicted >= 0.0) {
+            std::cout << "predicted " << predicted << "s of test time, actual " << actual << "s";
+        } else {
+            std::cout << actual << "s of test time";
+        }
+        if (cached > 0) {
+            std::cout << " (" << cached << " cached)";
+        }
+        std::cout << "\n";
+    }
 
     return failed > 0 ? 1 : 0;
 }
 
+// seconds in the unit that suits them
+static std::string format_seconds(double seconds) {
+    char buffer[32];
+    if (seconds >= 1.0) {
+        std::snprintf(buffer, sizeof(buffer), "%.3f s", seconds);
+    } else if (seconds >= 1e-3) {
+        std::snprintf(buffer, sizeof(buffer), "%.3f ms", seconds * 1e3);
+    } else {
+        std::snprintf(buffer, sizeof(buffer), "%.3f us", seconds * 1e6);
+    }
+    return buffer;
+}
+
+static std::string format_percent(double change) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%+.1f%%", change * 100.0);
+    return buffer;
+}
+
+int cmd_bench(const std::map<std::string, std::string>& options,
+              const std::vector<std::string>& positional) {
+    using namespace iris::ui;
+
+    std::string build_dir = options.count("builddir") && !options.at("builddir").empty() ? options.at("builddir") : "build";
+    std::string filter = options.count("filter") ? options.at("filter") : "";
+    std::string baseline_path = options.count("baseline") && !options.at("baseline").empty()
+                              ? options.at("baseline") : build_dir + "/" + core::BENCH_BASELINE;
+    bool save = options.count("save-baseline") && options.at("save-baseline") == "true";
+    std::string json = options.count("json") ? options.at("json") : "";
+
+    int repetitions = 0, warmup = 0, cpu = -1;
+    double threshold = 0.0;
+    try {
+        repetitions = std::stoi(options.at("repetitions"));
+        warmup = std::stoi(options.at("warmup"));
+        threshold = std::stod(options.at("threshold")) / 100.0;
+        cpu = options.count("cpu") && !options.at("cpu").empty() ? std::stoi(options.at("cpu"))
+                                                                 : core::BenchRunner::default_cpu();
+    } catch (const std::exception&) {
+        Terminal::error("--repetitions, --warmup, --threshold and --cpu take numbers");
+        return 1;
+    }
+    if (repetitions < 2) {
+        Terminal::error("--repetitions needs at least 2 runs for a confidence interval");
+        return 1;
+    }
+
+    int build_result = cmd_build({{"builddir", build_dir}}, {});
+    if (build_result != 0) {
+        return build_result;
+    }
+
+    Terminal::header("Running Benchmarks");
+
+    std::vector<core::Benchmark> benchmarks;
+    std::map<std::string, std::vector<double>> baseline;
+    try {
+        benchmarks = core::read_benchmarks(build_dir);
+        baseline = core::read_baseline(baseline_path);
+    } catch (const std::exception& e) {
+        Terminal::error(e.what());
+        Terminal::hint("Run 'iris setup' again to configure benchmark targets");
+        return 1;
+    }
+    if (!filter.empty()) {
+        benchmarks.erase(std::remove_if(benchmarks.begin(), benchmarks.end(), [&](const core::Benchmark& b) {
+            return b.name.find(filter) == std::string::npos;
+        }), benchmarks.end());
+    }
+    if (benchmarks.empty()) {
+        Terminal::warning("No benchmarks found");
+        Terminal::hint("Add a 'benchmark \"name\" do ... end' target to your iris.build file");
+        return 0;
+    }
+
+    core::BenchRunner runner(build_dir);
+    runner.set_repetitions(repetitions);
+    runner.set_warmup(warmup);
+    runner.set_cpu(cpu);
+    Terminal::info("CPU", cpu >= 0 ? std::to_string(cpu) : "not pinned");
+    if (!baseline.empty()) {
+        Terminal::info("Baseline", baseline_path);
+    }
+    std::cout << "\n";
+
+    std::vector<core::BenchResult> results;
+    int failed = 0, regressions = 0;
+    for (const auto& benchmark : benchmarks) {
+        core::BenchResult result;
+        try {
+            result = runner.run(benchmark);
+        } catch (const std::exception& e) {
+            Terminal::error(e.what());
+            return 1;
+        }
+        results.push_back(result);
+
+        std::cout << "  ";
+        if (!result.ok) {
+            Terminal::print_styled("FAIL ", Color::Red, Style::Bold);
+            std::cout << " " << result.name << ", exit code " << result.exit_code
+                      << " (see " << build_dir << "/" << result.log << ")\n";
+            failed++;
+            continue;
+        }
+
+        const auto& time = result.time;
+        Terminal::print_styled("BENCH", Color::Blue, Style::Bold);
+        std::cout << " " << result.name << "  " << format_seconds(time.mean) << " +/- "
+                  << format_seconds(time.high - time.mean) << "  (median " << format_seconds(time.median)
+                  << ", n=" << time.count;
+        if (time.outliers > 0) {
+            std::cout << ", " << time.outliers << (time.outliers == 1 ? " outlier" : " outliers") << " dropped";
+        }
+        std::cout << ")\n";
+
+        if (!result.counters.empty()) {
+            std::cout << "         ";
+            for (const auto& [name, value] : result.counters) {
+                char buffer[64];
+                std::snprintf(buffer, sizeof(buffer), "%s %.4g  ", name.c_str(), value);
+                std::cout << buffer;
+            }
+            if (result.counters.count("cycles") && result.counters.count("instructions") &&
+                result.counters.at("cycles") > 0) {
+                std::cout << "IPC " << std::fixed << std::setprecision(2)
+                          << result.counters.at("instructions") / result.counters.at("cycles");
+            }
+            std::cout << "\n";
+        }
+
+        auto found = baseline.find(result.name);
+        if (found != baseline.end()) {
+            auto change = core::compare(found->second, result.seconds, threshold);
+            std::cout << "         vs baseline " << format_percent(change.change) << " ["
+                      << format_percent(change.low) << ", " << format_percent(change.high) << "]  ";
+            if (change.regression) {
+                Terminal::print_styled("regression", Color::Red, Style::Bold);
+                regressions++;
+            } else if (change.improvement) {
+                Terminal::print_styled("improvement", Color::Green);
+            } else {
+                std::cout << "no significant change";
+            }
+            std::cout << "\n";
+        }
+    }
+
+    if (!runner.counters_available()) {
+        std::cout << "\n";
+        Terminal::hint("Hardware counters are unavailable, check /proc/sys/kernel/perf_event_paranoid");
+    }
+
+    try {
+        if (!json.empty()) {
+            core::write_bench_results(json, results);
+            Terminal::info("Report", json);
+        }
+        if (save && failed == 0) {
+            core::write_bench_results(baseline_path, results);
+            Terminal::info("Saved baseline", baseline_path);
+        }
+    } catch (const std::exception& e) {
+        Terminal::error(e.what());
+        return 1;
+    }
+
+    std::cout << "\n";
+    Terminal::separator();
+    std::cout << "  Results: " << results.size() - failed << " measured";
+    if (failed > 0) {
+        std::cout << ", ";
+        Terminal::print_styled(std::to_string(failed) + " failed", Color::Red);
+    }
+    if (regressions > 0) {
+        std::cout << ", ";
+        Terminal::print_styled(std::to_string(regressions) + " regressed", Color::Red);
+    }
+    std::cout << "\n";
+
+    return failed > 0 || regressions > 0 ? 1 : 0;
+}
+
 int cmd_info(const std::map<std::string, std::string>& options,
              const std::vector<std::string>& positional) {
     using namespace iris::ui;
@@ -471,6 +988,8 @@ int cmd_info(const std::map<std::string, std::string>& options,
                     Terminal::print_styled(" (executable)", Color::Gray);
                 } else if (target.type == core::TargetType::Library) {
                     Terminal::print_styled(" (library)", Color::Gray);
+                } else if (target.type == core::TargetType::Object) {
+                    Terminal::print_styled(" (object library)", Color::Gray);
                 }
                 std::cout << "\n";
             }
@@ -537,6 +1056,322 @@ int cmd_graph(const std::map<std::string, std::string>& options,
     return 0;
 }
 
+// a stand-in for a shared cache server: GET, HEAD and PUT on /ac/<key> and
+// /cas/<hash>, kept in the same layout as a local cache. there is no
+// eviction, run "iris cache gc" against the directory for that
+static int serve_cache(const std::string& dir, const std::string& bind, const std::string& port) {
+    using namespace iris::ui;
+
+    try {
+        util::http::Server server(bind, port);
+        fs::create_directories(dir);
+        Terminal::info("Serving", fs::absolute(dir).string() + " on http://" + bind + ":" +
+                       std::to_string(server.port()));
+        std::cout << std::flush;
+
+        server.serve([dir](const util::http::Request& request) -> util::http::Response {
+            std::string path = request.path.substr(0, request.path.find('?'));
+            size_t slash = path.find('/', 1);
+            std::string kind = path.substr(1, slash == std::string::npos ? 0 : slash - 1);
+            std::string name = slash == std::string::npos ? "" : path.substr(slash + 1);
+
+            bool valid = (kind == "ac" || kind == "cas") && name.size() >= 2 &&
+                         std::all_of(name.begin(), name.end(),
+                             [](unsigned char c) { return std::isalnum(c); });
+            if (!valid) {
+                return {404, ""};
+            }
+
+            std::string file = dir + "/" + kind + "/" + name.substr(0, 2) + "/" + name;
+            if (request.method == "GET" || request.method == "HEAD") {
+                if (!util::fs::is_file(file)) {
+                    return {404, ""};
+                }
+                return {200, util::fs::read_file(file)};
+            }
+            if (request.method == "PUT") {
+                // through a temporary, concurrent readers never see half a file
+                static std::atomic<unsigned> counter{0};
+                std::string temp = file + ".tmp" + std::to_string(counter++);
+                fs::create_directories(fs::path(file).parent_path());
+                if (!util::fs::write_file(temp, request.body)) {
+                    return {500, ""};
+                }
+                fs::rename(temp, file);
+                return {201, ""};
+            }
+            return {405, ""};
+        });
+    } catch (const std::exception& e) {
+        Terminal::error(e.what());
+        return 1;
+    }
+    return 0;
+}
+
+// export writes the entries a build used into one archive, import puts
+// one back, e.g. to seed a fresh CI runner. "-" streams through stdout or
+// stdin, messages then go to stderr
+static int transfer_cache(const std::string& dir, const std::string& action, const std::string& file,
+                          const std::map<std::string, std::string>& options) {
+    using namespace iris::ui;
+
+    if (file.empty()) {
+        Terminal::error("Usage: iris cache " + action + " <file>");
+        return 1;
+    }
+    if (action == "export" && !fs::exists(dir)) {
+        Terminal::warning("No build cache at " + dir);
+        return 0;
+    }
+
+    try {
+        auto start = std::chrono::steady_clock::now();
+        core::Cache cache(dir);
+        core::ArchiveStats stats;
+
+        if (action == "export") {
+            // a stamp file touched before the build, or an age
+            int64_t since = 0;
+            if (options.count("since")) {
+                std::string value = options.at("since");
+                if (fs::exists(value)) {
+                    since = util::fs::modification_time(value);
+                } else if (core::parse_age(value) > 0) {
+                    since = std::chrono::duration_cast<std::chrono::seconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count() - core::parse_age(value);
+                } else {
+                    Terminal::error("--since takes a stamp file or an age like 2h: " + value);
+                    return 1;
+                }
+            }
+            cache.load();
+            stats = cache.export_archive(file, since);
+        } else {
+            stats = cache.import_archive(file);
+        }
+
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        char summary[160];
+        std::snprintf(summary, sizeof(summary), "%s %zu entries (%zu blobs, %s%s) in %.2fs",
+                      action == "export" ? "Exported" : "Imported", stats.entries, stats.blobs,
+                      core::format_size(stats.bytes).c_str(),
+                      stats.reflinked ? (", " + std::to_string(stats.reflinked) + " reflinked").c_str() : "",
+                      secs);
+        std::string rejected = std::to_string(stats.rejected) +
+                               " blobs did not match their digest, entries using them were skipped";
+        if (file == "-") {
+            std::cerr << summary << "\n";
+            if (stats.rejected) std::cerr << "iris: " << rejected << "\n";
+        } else {
+            Terminal::success(summary);
+            if (stats.rejected) Terminal::warning(rejected);
+        }
+    } catch (const std::exception& e) {
+        if (file == "-") {
+            std::cerr << "iris: " << e.what() << "\n";
+        } else {
+            Terminal::error(e.what());
+        }
+        return 1;
+    }
+    return 0;
+}
+
+int cmd_cache(const std::map<std::string, std::string>& options,
+              const std::vector<std::string>& positional) {
+    using namespace iris::ui;
+
+    std::string action = positional.empty() ? "stats" : positional[0];
+    const char* env_cache = std::getenv("IRIS_CACHE_DIR");
+    std::string dir = options.count("dir") ? options.at("dir")
+                    : env_cache && *env_cache ? env_cache : ".iris-cache";
+
+    if (action == "serve") {
+        return serve_cache(dir, options.at("bind"), options.at("port"));
+    }
+    if (action == "export" || action == "import") {
+        return transfer_cache(dir, action, positional.size() > 1 ? positional[1] : "", options);
+    }
+
+    if (!fs::exists(dir)) {
+        Terminal::warning("No build cache at " + dir);
+        return 0;
+    }
+
+    try {
+        core::Cache cache(dir);
+
+        if (action == "stats") {
+            cache.load();
+            auto stats = cache.stats();
+            uint64_t lookups = stats.hits + stats.misses;
+
+            Terminal::header("Build Cache");
+            Terminal::info("Directory", dir);
+            Terminal::info("Entries", std::to_string(stats.entries));
+            Terminal::info("Size", core::format_size(stats.bytes));
+            if (stats.bytes > 0 && stats.raw_bytes != stats.bytes) {
+                char ratio[32];
+                std::snprintf(ratio, sizeof(ratio), "%.2fx", double(stats.raw_bytes) / stats.bytes);
+                Terminal::info("Uncompressed", core::format_size(stats.raw_bytes) + " (" + ratio + ")");
+            }
+            Terminal::info("Hits", std::to_string(stats.hits));
+            Terminal::info("Misses", std::to_string(stats.misses));
+            if (lookups > 0) {
+                Terminal::info("Hit rate", std::to_string(stats.hits * 100 / lookups) + "%");
+            }
+            if (stats.remote_hits > 0) {
+                Terminal::info("Remote hits", std::to_string(stats.remote_hits) + " (" +
+                               core::format_size(stats.fetched_bytes) + " fetched)");
+            }
+            if (stats.restore_micros > 0) {
+                // decompression included, compare against plain disk speed
+                char speed[64];
+                std::snprintf(speed, sizeof(speed), "%.1f MB/s (%.1f ms total)",
+                              stats.restored_bytes / double(stats.restore_micros),
+                              stats.restore_micros / 1000.0);
+                Terminal::info("Restore speed", speed);
+            }
+
+            if (!stats.largest.empty()) {
+                std::cout << "\n";
+                Terminal::subheader("Largest entries");
+                for (const auto& entry : stats.largest) {
+                    std::cout << "  " << std::setw(10) << core::format_size(entry.size())
+                              << "  " << entry.label << "\n";
+                }
+            }
+        } else if (action == "gc") {
+            uint64_t max_size = options.count("max-size") ? core::parse_size(options.at("max-size")) : 0;
+            int64_t max_age = options.count("max-age") ? core::parse_age(options.at("max-age")) : 0;
+            if (max_size == 0 && max_age == 0) {
+                Terminal::error("Nothing to collect, give --max-size and/or --max-age");
+                return 1;
+            }
+
+            cache.load();
+            uint64_t before = cache.stats().bytes;
+            size_t removed = cache.gc(max_size, max_age);
+            uint64_t after = cache.stats().bytes;
+
+            Terminal::success("Removed " + std::to_string(removed) + " entries, freed " +
+                              core::format_size(before - std::min(before, after)));
+        } else if (action == "push") {
+            const char* env_remote = std::getenv("IRIS_REMOTE_CACHE");
+            std::string remote = options.count("remote") ? options.at("remote")
+                               : env_remote ? env_remote : "";
+            if (remote.empty()) {
+                Terminal::error("No remote cache, give --remote or set IRIS_REMOTE_CACHE");
+                return 1;
+            }
+
+            cache.set_remote(remote);
+            size_t uploaded = cache.push(true);
+            size_t left = util::fs::list_directory(dir + "/outbox").size();
+            Terminal::success("Uploaded " + std::to_string(uploaded) + " entries to " + remote);
+            if (left > 0) {
+                Terminal::warning(std::to_string(left) + " entries could not be uploaded yet");
+                return 1;
+            }
+        } else {
+            Terminal::error("Unknown cache action: " + action);
+            Terminal::hint("Use 'iris cache stats', 'gc', 'export', 'import', 'push' or 'serve'");
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        Terminal::error(e.what());
+        return 1;
+    }
+
+    return 0;
+}
+
+int cmd_collate_modules(const std::map<std::string, std::string>& options,
+                        const std::vector<std::string>& positional) {
+    using namespace iris::ui;
+
+    try {
+        core::collate_modules(options.at("units"), options.at("output"), options.at("format"));
+    } catch (const std::exception& e) {
+        Terminal::error(e.what());
+        return 1;
+    }
+
+    return 0;
+}
+
+int cmd_compile(const std::map<std::string, std::string>& options,
+                const std::vector<std::string>& positional) {
+    using namespace iris::ui;
+
+    if (positional.size() < 3 || positional[1] != "--") {
+        Terminal::error("Usage: iris compile <output> -- <command...>");
+        return 1;
+    }
+
+    try {
+        std::vector<std::string> command(positional.begin() + 2, positional.end());
+        std::string cache_dir = options.count("cache") ? options.at("cache") : "";
+        std::string root = options.count("root") ? options.at("root") : "";
+        std::string remote = options.count("remote") ? options.at("remote") : "";
+        return core::compile_with_cutoff(positional[0], command, cache_dir, root, remote);
+    } catch (const std::exception& e) {
+        Terminal::error(e.what());
+        return 1;
+    }
+}
+
+int cmd_compile_batch(const std::map<std::string, std::string>& options,
+                      const std::vector<std::string>& positional) {
+    using namespace iris::ui;
+    (void)options;
+
+    auto marker = std::find(positional.begin(), positional.end(), "--");
+    if (positional.size() < 2 || marker == positional.end() || marker + 1 == positional.end()) {
+        Terminal::error("Usage: iris compile-batch <batch> <source=object>... -- <command...>");
+        return 1;
+    }
+
+    std::vector<std::pair<std::string, std::string>> sources;
+    for (auto it = positional.begin() + 1; it != marker; ++it) {
+        size_t eq = it->find('=');
+        if (eq == std::string::npos) {
+            Terminal::error("Expected source=object, got " + *it);
+            return 1;
+        }
+        sources.emplace_back(it->substr(0, eq), it->substr(eq + 1));
+    }
+
+    try {
+        std::vector<std::string> command(marker + 1, positional.end());
+        return core::compile_batch(positional[0], sources, command);
+    } catch (const std::exception& e) {
+        Terminal::error(e.what());
+        return 1;
+    }
+}
+
+int cmd_interface(const std::map<std::string, std::string>& options,
+                  const std::vector<std::string>& positional) {
+    using namespace iris::ui;
+    (void)options;
+
+    if (positional.size() != 2) {
+        Terminal::error("Usage: iris interface <library> <output>");
+        return 1;
+    }
+
+    try {
+        core::update_interface(positional[0], positional[1]);
+    } catch (const std::exception& e) {
+        Terminal::error(e.what());
+        return 1;
+    }
+
+    return 0;
+}
+
 
 int cmd_install(const std::map<std::string, std::string>& options,
                 const std::vector<std::string>& positional) {
@@ -24,13 +24,31 @@ int cmd_run(const std::map<std::string, std::string>& options,
 int cmd_test(const std::map<std::string, std::string>& options,
              const std::vector<std::string>& positional);
 
+int cmd_bench(const std::map<std::string, std::string>& options,
+              const std::vector<std::string>& positional);
+
 int cmd_info(const std::map<std::string, std::string>& options,
              const std::vector<std::string>& positional);
 
 int cmd_graph(const std::map<std::string, std::string>& options,
               const std::vector<std::string>& positional);
 
+int cmd_cache(const std::map<std::string, std::string>& options,
+              const std::vector<std::string>& positional);
+
 int cmd_install(const std::map<std::string, std::string>& options,
                 const std::vector<std::string>& positional);
 
+int cmd_collate_modules(const std::map<std::string, std::string>& options,
+                        const std::vector<std::string>& positional);
+
+int cmd_compile(const std::map<std::string, std::string>& options,
+                const std::vector<std::string>& positional);
+
+int cmd_compile_batch(const std::map<std::string, std::string>& options,
+                      const std::vector<std::string>& positional);
+
+int cmd_interface(const std::map<std::string, std::string>& options,
+                  const std::vector<std::string>& positional);
+
 } // namespace iris::cli::commands
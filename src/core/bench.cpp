@@ -0,0 +1,442 @@
+#include "bench.hpp"
+#include "../util/fs.hpp"
+#include "../util/json.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+extern char** environ;
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace iris::core {
+
+namespace {
+
+struct Counter {
+    const char* name;
+    uint64_t config;
+};
+
+#ifdef __linux__
+const Counter COUNTERS[] = {
+    {"cycles", PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache_misses", PERF_COUNT_HW_CACHE_MISSES},
+    {"branch_misses", PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+// counts user space of pid and everything it forks, from its exec on
+int open_counter(pid_t pid, uint64_t config) {
+    perf_event_attr attr {};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = 1;
+    attr.enable_on_exec = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+
+// the count scaled up for the time the counter was multiplexed out, or
+// negative when it never ran
+double read_counter(int fd) {
+    uint64_t values[3] = {0, 0, 0};
+    if (read(fd, values, sizeof(values)) != static_cast<ssize_t>(sizeof(values)) || values[2] == 0) {
+        return -1.0;
+    }
+    return static_cast<double>(values[0]) * static_cast<double>(values[1]) / static_cast<double>(values[2]);
+}
+#endif
+
+// two-sided 95% quantiles of student's t for 1 to 30 degrees of freedom
+const double T_TABLE[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+double t_quantile(double df) {
+    if (df < 1.0) return T_TABLE[0];
+    if (df <= 30.0) return T_TABLE[static_cast<int>(df) - 1];
+    if (df <= 40.0) return 2.021;
+    if (df <= 60.0) return 2.000;
+    if (df <= 120.0) return 1.980;
+    return 1.960;
+}
+
+// linear interpolation between closest ranks, samples sorted
+double quantile(const std::vector<double>& sorted, double q) {
+    double position = q * static_cast<double>(sorted.size() - 1);
+    size_t below = static_cast<size_t>(position);
+    size_t above = std::min(below + 1, sorted.size() - 1);
+    return sorted[below] + (sorted[above] - sorted[below]) * (position - static_cast<double>(below));
+}
+
+double mean_of(const std::vector<double>& samples) {
+    double sum = 0.0;
+    for (double sample : samples) sum += sample;
+    return samples.empty() ? 0.0 : sum / static_cast<double>(samples.size());
+}
+
+double variance_of(const std::vector<double>& samples, double mean) {
+    if (samples.size() < 2) return 0.0;
+    double sum = 0.0;
+    for (double sample : samples) sum += (sample - mean) * (sample - mean);
+    return sum / static_cast<double>(samples.size() - 1);
+}
+
+double median_of(std::vector<double> samples) {
+    if (samples.empty()) return 0.0;
+    std::sort(samples.begin(), samples.end());
+    return quantile(samples, 0.5);
+}
+
+std::string log_name(const std::string& name) {
+    std::string file;
+    for (char c : name) {
+        bool keep = std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.';
+        file += keep ? c : '_';
+    }
+    return file + ".log";
+}
+
+} // namespace
+
+std::vector<Benchmark> read_benchmarks(const std::string& build_dir) {
+    std::string path = build_dir + "/" + BENCHMARKS_FILE;
+    if (!util::fs::exists(path)) {
+        throw std::runtime_error("No benchmark list in " + build_dir);
+    }
+
+    util::json::Value doc = util::json::parse(util::fs::read_file(path));
+    std::vector<Benchmark> benchmarks;
+    const auto& list = doc["benchmarks"];
+    for (size_t i = 0; i < list.size(); i++) {
+        const auto& entry = list[i];
+        Benchmark benchmark;
+        benchmark.name = entry["name"].as_string();
+        benchmark.executable = entry["executable"].as_string();
+        for (size_t a = 0; a < entry["args"].size(); a++) {
+            benchmark.args.push_back(entry["args"][a].as_string());
+        }
+        for (const auto& [name, value] : entry["env"].object) {
+            benchmark.env[name] = value.as_string();
+        }
+        benchmark.working_dir = entry["working_dir"].as_string();
+        benchmark.repetitions = static_cast<int>(entry["repetitions"].as_number());
+        benchmark.warmup = entry["warmup"].is_null() ? -1 : static_cast<int>(entry["warmup"].as_number());
+        benchmarks.push_back(std::move(benchmark));
+    }
+    return benchmarks;
+}
+
+Statistics summarize(std::vector<double>& samples) {
+    Statistics stats;
+    if (samples.size() >= 4) {
+        std::vector<double> sorted = samples;
+        std::sort(sorted.begin(), sorted.end());
+        double q1 = quantile(sorted, 0.25);
+        double q3 = quantile(sorted, 0.75);
+        double fence = 1.5 * (q3 - q1);
+        auto outside = std::remove_if(samples.begin(), samples.end(), [&](double sample) {
+            return sample < q1 - fence || sample > q3 + fence;
+        });
+        stats.outliers = static_cast<size_t>(samples.end() - outside);
+        samples.erase(outside, samples.end());
+    }
+
+    stats.count = samples.size();
+    stats.mean = mean_of(samples);
+    stats.median = median_of(samples);
+    stats.stddev = std::sqrt(variance_of(samples, stats.mean));
+    double margin = samples.size() < 2 ? 0.0
+                  : t_quantile(static_cast<double>(samples.size() - 1)) * stats.stddev /
+                    std::sqrt(static_cast<double>(samples.size()));
+    stats.low = stats.mean - margin;
+    stats.high = stats.mean + margin;
+    return stats;
+}
+
+Comparison compare(const std::vector<double>& baseline,
+                   const std::vector<double>& current,
+                   double threshold) {
+    Comparison result;
+    double base = mean_of(baseline);
+    if (baseline.empty() || current.empty() || base <= 0.0) {
+        return result;
+    }
+
+    double now = mean_of(current);
+    double va = variance_of(baseline, base) / static_cast<double>(baseline.size());
+    double vb = variance_of(current, now) / static_cast<double>(current.size());
+    double se = std::sqrt(va + vb);
+
+    // welch-satterthwaite degrees of freedom
+    double df = 1.0;
+    if (se > 0.0) {
+        double denominator = 0.0;
+        if (baseline.size() > 1) denominator += va * va / static_cast<double>(baseline.size() - 1);
+        if (current.size() > 1) denominator += vb * vb / static_cast<double>(current.size() - 1);
+        df = denominator > 0.0 ? (va + vb) * (va + vb) / denominator : 1.0;
+    }
+    double margin = t_quantile(df) * se;
+
+    result.change = (now - base) / base;
+    result.low = (now - base - margin) / base;
+    result.high = (now - base + margin) / base;
+    result.regression = result.low > 0.0 && result.change > threshold;
+    result.improvement = result.high < 0.0 && -result.change > threshold;
+    return result;
+}
+
+std::map<std::string, std::vector<double>> read_baseline(const std::string& path) {
+    std::map<std::string, std::vector<double>> baseline;
+    if (!util::fs::exists(path)) {
+        return baseline;
+    }
+    util::json::Value doc = util::json::parse(util::fs::read_file(path));
+    const auto& list = doc["benchmarks"];
+    for (size_t i = 0; i < list.size(); i++) {
+        auto& samples = baseline[list[i]["name"].as_string()];
+        for (size_t s = 0; s < list[i]["samples"].size(); s++) {
+            samples.push_back(list[i]["samples"][s].as_number());
+        }
+    }
+    return baseline;
+}
+
+void write_bench_results(const std::string& path, const std::vector<BenchResult>& results) {
+    auto number = [](double value) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+        return std::string(buffer);
+    };
+
+    std::ostringstream json;
+    json << "{\n  \"benchmarks\": [";
+    bool first = true;
+    for (const auto& result : results) {
+        if (!result.ok) continue;
+        json << (first ? "\n" : ",\n");
+        json << "    {\n";
+        json << "      \"name\": \"" << util::json::escape(result.name) << "\",\n";
+        json << "      \"mean\": " << number(result.time.mean) << ",\n";
+        json << "      \"median\": " << number(result.time.median) << ",\n";
+        json << "      \"stddev\": " << number(result.time.stddev) << ",\n";
+        json << "      \"low\": " << number(result.time.low) << ",\n";
+        json << "      \"high\": " << number(result.time.high) << ",\n";
+        json << "      \"outliers\": " << result.time.outliers << ",\n";
+        json << "      \"samples\": [";
+        for (size_t i = 0; i < result.seconds.size(); i++) {
+            json << (i ? ", " : "") << number(result.seconds[i]);
+        }
+        json << "],\n      \"counters\": {";
+        bool first_counter = true;
+        for (const auto& [name, value] : result.counters) {
+            json << (first_counter ? "\"" : ", \"") << name << "\": " << number(value);
+            first_counter = false;
+        }
+        json << "}\n    }";
+        first = false;
+    }
+    json << "\n  ]\n}\n";
+
+    std::string directory = util::fs::dirname(path);
+    if (!directory.empty()) {
+        util::fs::create_directories(directory);
+    }
+    if (!util::fs::write_file(path, json.str())) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+}
+
+BenchRunner::BenchRunner(const std::string& build_dir) : m_build_dir(build_dir) {}
+
+void BenchRunner::set_repetitions(int repetitions) {
+    m_repetitions = std::max(1, repetitions);
+}
+
+void BenchRunner::set_warmup(int warmup) {
+    m_warmup = std::max(0, warmup);
+}
+
+void BenchRunner::set_cpu(int cpu) {
+    m_cpu = cpu;
+}
+
+int BenchRunner::default_cpu() {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = CPU_SETSIZE - 1; cpu >= 0; cpu--) {
+            if (CPU_ISSET(cpu, &set)) return cpu;
+        }
+    }
+#endif
+    return -1;
+}
+
+BenchResult BenchRunner::run(const Benchmark& benchmark) {
+    BenchResult result;
+    result.name = benchmark.name;
+    result.log = std::string(BENCH_LOGS) + "/" + log_name(benchmark.name);
+    util::fs::create_directories(m_build_dir + "/" + BENCH_LOGS);
+
+#ifdef _WIN32
+    (void)m_cpu;
+    throw std::runtime_error("iris bench needs a POSIX system");
+#else
+    std::string log_path = m_build_dir + "/" + result.log;
+    std::string executable = fs::absolute(m_build_dir + "/" + benchmark.executable).lexically_normal().string();
+
+    // everything the child needs is built before fork
+    std::vector<std::string> arguments = {executable};
+    arguments.insert(arguments.end(), benchmark.args.begin(), benchmark.args.end());
+    std::vector<char*> argv;
+    for (auto& arg : arguments) argv.push_back(arg.data());
+    argv.push_back(nullptr);
+
+    std::vector<std::string> variables;
+    for (char** entry = environ; *entry; entry++) {
+        std::string variable = *entry;
+        if (!benchmark.env.count(variable.substr(0, variable.find('=')))) {
+            variables.push_back(variable);
+        }
+    }
+    for (const auto& [name, value] : benchmark.env) {
+        variables.push_back(name + "=" + value);
+    }
+    std::vector<char*> envp;
+    for (auto& variable : variables) envp.push_back(variable.data());
+    envp.push_back(nullptr);
+
+    int repetitions = benchmark.repetitions > 0 ? benchmark.repetitions : m_repetitions;
+    int warmup = benchmark.warmup >= 0 ? benchmark.warmup : m_warmup;
+    std::map<std::string, std::vector<double>> counts;
+
+    result.ok = true;
+    for (int run = 0; run < warmup + repetitions; run++) {
+        int output = open(log_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        int input = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        int gate[2] = {-1, -1};
+        if (output < 0 || input < 0 || pipe(gate) != 0) {
+            if (output >= 0) close(output);
+            if (input >= 0) close(input);
+            throw std::runtime_error("Cannot write " + log_path);
+        }
+        fcntl(gate[0], F_SETFD, FD_CLOEXEC);
+        fcntl(gate[1], F_SETFD, FD_CLOEXEC);
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            close(gate[0]);
+            close(gate[1]);
+            close(output);
+            close(input);
+            throw std::runtime_error("Failed to start " + benchmark.name);
+        }
+        if (pid == 0) {
+            // pinned before exec, then held until the counters are attached
+#ifdef __linux__
+            if (m_cpu >= 0) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(m_cpu, &set);
+                sched_setaffinity(0, sizeof(set), &set);
+            }
+#endif
+            dup2(input, 0);
+            dup2(output, 1);
+            dup2(output, 2);
+            char go = 0;
+            if (read(gate[0], &go, 1) != 1) _exit(127);
+            if (!benchmark.working_dir.empty() && chdir(benchmark.working_dir.c_str()) != 0) _exit(127);
+            execve(argv[0], argv.data(), envp.data());
+            _exit(127);
+        }
+        close(gate[0]);
+        close(output);
+        close(input);
+
+        std::vector<int> fds;
+#ifdef __linux__
+        if (m_counters) {
+            for (const auto& counter : COUNTERS) {
+                fds.push_back(open_counter(pid, counter.config));
+            }
+        }
+#endif
+
+        auto start = std::chrono::steady_clock::now();
+        ssize_t released = write(gate[1], "x", 1);
+        (void)released;
+        close(gate[1]);
+        int status = 0;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        int exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        bool measured = run >= warmup;
+        for (size_t i = 0; i < fds.size(); i++) {
+#ifdef __linux__
+            double value = fds[i] >= 0 ? read_counter(fds[i]) : -1.0;
+            if (value >= 0.0 && measured) {
+                counts[COUNTERS[i].name].push_back(value);
+            }
+#endif
+            if (fds[i] >= 0) close(fds[i]);
+        }
+        if (std::none_of(fds.begin(), fds.end(), [](int fd) { return fd >= 0; })) {
+            m_counters = false;
+        }
+
+        if (exit_code != 0) {
+            result.ok = false;
+            result.exit_code = exit_code;
+            return result;
+        }
+        if (measured) {
+            result.seconds.push_back(seconds);
+        }
+    }
+
+    if (counts.empty()) {
+        m_counters = false;
+    }
+    result.time = summarize(result.seconds);
+    for (const auto& [name, values] : counts) {
+        if (values.size() == static_cast<size_t>(repetitions)) {
+            result.counters[name] = median_of(values);
+        }
+    }
+#endif
+    return result;
+}
+
+} // namespace iris::core
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace iris::core {
+
+// benchmark targets as setup wrote them, relative to the build dir
+constexpr const char* BENCHMARKS_FILE = "benchmarks.json";
+
+// output of the last run of each benchmark, relative to the build dir
+constexpr const char* BENCH_LOGS = "benchlogs";
+
+// results iris bench compares with unless told otherwise, relative to the
+// build dir
+constexpr const char* BENCH_BASELINE = "bench-baseline.json";
+
+struct Benchmark {
+    std::string name;
+    std::string executable;             // relative to the build dir
+    std::vector<std::string> args;
+    std::map<std::string, std::string> env;  // added to the environment iris runs in
+    std::string working_dir;            // absolute
+    int repetitions = 0;                // 0 uses the runner's
+    int warmup = -1;                    // -1 uses the runner's
+};
+
+// summary of the samples left after outlier rejection
+struct Statistics {
+    size_t count = 0;
+    size_t outliers = 0;                // samples outside the tukey fences
+    double mean = 0.0;
+    double median = 0.0;
+    double stddev = 0.0;
+    double low = 0.0;                   // 95% confidence interval of the mean
+    double high = 0.0;
+};
+
+struct BenchResult {
+    std::string name;
+    bool ok = false;                    // every run exited with 0
+    int exit_code = 0;                  // of the first run that did not
+    std::string log;                    // relative to the build dir
+    std::vector<double> seconds;        // wall time of each measured run, outliers removed
+    Statistics time;
+    std::map<std::string, double> counters;  // median per run, those perf could count
+};
+
+// the current mean against a baseline, as relative changes
+struct Comparison {
+    double change = 0.0;
+    double low = 0.0;                   // 95% confidence interval of the change
+    double high = 0.0;
+    bool regression = false;            // slower beyond the threshold, and significantly so
+    bool improvement = false;
+};
+
+// throws std::runtime_error when setup wrote no benchmark list
+std::vector<Benchmark> read_benchmarks(const std::string& build_dir);
+
+// drops outliers from samples (tukey fences, from four samples on) and
+// summarizes the rest
+Statistics summarize(std::vector<double>& samples);
+
+// welch's interval for the difference of the means. threshold is the
+// relative change below which nothing counts, 0.05 for 5%
+Comparison compare(const std::vector<double>& baseline,
+                   const std::vector<double>& current,
+                   double threshold);
+
+// samples per benchmark from a file written by write_bench_results, empty
+// when there is none
+std::map<std::string, std::vector<double>> read_baseline(const std::string& path);
+void write_bench_results(const std::string& path, const std::vector<BenchResult>& results);
+
+// runs benchmarks one at a time, pinned to a single cpu, counting cycles,
+// instructions, cache and branch misses through perf_event_open where the
+// kernel allows it
+class BenchRunner {
+public:
+    explicit BenchRunner(const std::string& build_dir);
+
+    void set_repetitions(int repetitions);
+    void set_warmup(int warmup);
+    void set_cpu(int cpu);              // -1 leaves scheduling alone
+
+    // the cpu picked when none is set: the last one iris may run on
+    static int default_cpu();
+
+    BenchResult run(const Benchmark& benchmark);
+
+    // false once a run found no hardware counters
+    bool counters_available() const { return m_counters; }
+
+private:
+    std::string m_build_dir;
+    int m_repetitions = 10;
+    int m_warmup = 1;
+    int m_cpu = -1;
+    bool m_counters = true;
+};
+
+} // namespace iris::core
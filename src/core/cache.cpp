@@ -1,24 +1,443 @@
 #include "cache.hpp"
 #include "../util/hash.hpp"
+#include "../util/fs.hpp"
+#include "../util/json.hpp"
+#include "../util/compress.hpp"
+#include "../util/http.hpp"
 
 #include <fstream>
 #include <sstream>
 #include <filesystem>
+#include <algorithm>
+#include <set>
+#include <atomic>
+#include <array>
 #include <chrono>
+#include <thread>
+#include <mutex>
+#include <random>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
 
 namespace fs = std::filesystem;
 
 namespace iris::core {
 
-Cache::Cache(const std::string& cache_dir) : m_cache_dir(cache_dir) {
-    fs::create_directories(m_cache_dir);
-    load();
+namespace {
+
+// journal size that makes a store try to compact
+constexpr uint64_t COMPACT_THRESHOLD = 256 * 1024;
+
+// orphaned files younger than this may belong to a store in flight
+constexpr int64_t ORPHAN_GRACE = 600;
+
+// remembered remote misses are forgotten after this, entries other
+// machines uploaded since then are found again
+constexpr int64_t MISS_FILTER_TTL = 900;
+
+// bits in the miss filter and bits set per key. 8M bits stay below a 1%
+// false positive rate up to ~800k keys
+constexpr uint64_t MISS_FILTER_BITS = 8ull << 20;
+constexpr int MISS_FILTER_HASHES = 4;
+constexpr size_t MISS_FILTER_HEADER = 16;
+
+// after a failed request the remote is left alone this long, so a build
+// with the server down doesn't wait for a timeout on every compile
+constexpr int64_t REMOTE_RETRY_DELAY = 60;
+
+int64_t now_seconds() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+}
+
+enum class LockMode { Shared, Exclusive, TryExclusive };
+
+// advisory lock on <cache>/lock. appends hold it shared, compaction and gc
+// exclusively
+class CacheLock {
+public:
+    CacheLock(const std::string& path, LockMode mode) {
+#ifndef _WIN32
+        m_fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (m_fd < 0) {
+            return;
+        }
+        int op = mode == LockMode::Shared ? LOCK_SH
+               : mode == LockMode::Exclusive ? LOCK_EX : LOCK_EX | LOCK_NB;
+        if (flock(m_fd, op) != 0) {
+            close(m_fd);
+            m_fd = -1;
+        }
+#else
+        (void)path;
+        (void)mode;
+        m_fd = 0;
+#endif
+    }
+
+    ~CacheLock() {
+#ifndef _WIN32
+        if (m_fd >= 0) {
+            flock(m_fd, LOCK_UN);
+            close(m_fd);
+        }
+#endif
+    }
+
+    bool held() const { return m_fd >= 0; }
+
+    CacheLock(const CacheLock&) = delete;
+    CacheLock& operator=(const CacheLock&) = delete;
+
+private:
+    int m_fd = -1;
+};
+
+uint32_t crc32(const std::string& data) {
+    static const auto table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (unsigned char byte : data) {
+        crc = table[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
 }
 
-Cache::~Cache() {
-    if (m_dirty) {
-        save();
+// journal line: 8 hex digits of crc32, a space and the record
+std::string frame(const std::string& record) {
+    char crc[9];
+    std::snprintf(crc, sizeof(crc), "%08x", crc32(record));
+    return std::string(crc) + " " + record + "\n";
+}
+
+// the record of a journal line, empty when torn or damaged
+std::string unframe(const std::string& line) {
+    if (line.size() < 10 || line[8] != ' ') {
+        return "";
     }
+    std::string record = line.substr(9);
+    char crc[9];
+    std::snprintf(crc, sizeof(crc), "%08x", crc32(record));
+    return line.compare(0, 8, crc) == 0 ? record : "";
+}
+
+std::string unique_suffix() {
+    static std::atomic<unsigned> counter{0};
+#ifndef _WIN32
+    return std::to_string(getpid()) + "." + std::to_string(counter++);
+#else
+    return std::to_string(counter++);
+#endif
+}
+
+// writes through a temporary so readers never see a partial file
+bool write_atomic(const std::string& path, const std::string& content) {
+    fs::create_directories(fs::path(path).parent_path());
+    std::string temp = path + ".tmp" + unique_suffix();
+    if (!util::fs::write_file(temp, content)) {
+        return false;
+    }
+    std::error_code ec;
+    fs::rename(temp, path, ec);
+    if (ec) {
+        fs::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
+
+// moves a blob written to temp into the store once its contents decode to
+// the digest it is named by, and drops it otherwise
+bool commit_blob(const std::string& temp, const std::string& dest, const std::string& hash) {
+    std::string check = temp + ".raw";
+    bool valid = false;
+    try {
+        util::compress::decompress_file(temp, check);
+        valid = util::hash::sha256(util::fs::read_file(check)) == hash;
+    } catch (const std::exception&) {
+    }
+    util::fs::remove_file(check);
+    std::error_code ec;
+    if (valid) {
+        fs::rename(temp, dest, ec);
+    }
+    if (!valid || ec) {
+        fs::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
+
+// cache archive layout, integers little endian:
+//   "IRISCAR1"
+//   records of kind:u8 name_length:u16 data_length:u64 name data, blobs
+//   ('b', named by hash) first, then action entries ('a', named by key) and
+//   last the index ('i'), one "<kind> <name> <data offset> <length>" line
+//   per record. 'p' records are padding
+//   index_offset:u64 "IRISEND1"
+// a reader can stream the records in order or jump to the index through
+// the trailer. blobs of REFLINK_MIN and up start on a REFLINK_ALIGN boundary,
+// so they can be cloned out of the archive on filesystems that share extents
+const char ARCHIVE_MAGIC[] = "IRISCAR1";
+const char ARCHIVE_END[] = "IRISEND1";
+constexpr size_t RECORD_HEADER = 11;
+constexpr size_t ARCHIVE_TRAILER = 16;
+constexpr uint64_t REFLINK_ALIGN = 4096;
+constexpr uint64_t REFLINK_MIN = 64 * 1024;
+
+void put_le(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+uint64_t get_le(const std::string& in, size_t offset, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(in[offset + i])) << (8 * i);
+    }
+    return value;
+}
+
+enum class Extracted { Copied, Reflinked, Rejected };
+
+// copies length bytes at offset of an archive into the blob named hash,
+// cloning the block aligned part when the filesystem can. a blob that does
+// not match its digest is rejected and nothing is written
+Extracted extract(const std::string& archive, uint64_t offset, uint64_t length,
+                  const std::string& dest, const std::string& hash) {
+    std::string temp = dest + ".tmp" + unique_suffix();
+    fs::create_directories(fs::path(dest).parent_path());
+    uint64_t cloned = 0;
+
+#ifdef __linux__
+#ifdef FICLONERANGE
+    if (offset % REFLINK_ALIGN == 0 && length >= REFLINK_MIN) {
+        int src = open(archive.c_str(), O_RDONLY);
+        int dst = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (src >= 0 && dst >= 0) {
+            file_clone_range range{};
+            range.src_fd = src;
+            range.src_offset = offset;
+            range.src_length = length / REFLINK_ALIGN * REFLINK_ALIGN;
+            if (ioctl(dst, FICLONERANGE, &range) == 0) {
+                cloned = range.src_length;
+            }
+        }
+        if (src >= 0) close(src);
+        if (dst >= 0) close(dst);
+    }
+#endif
+#endif
+
+    // the rest, or everything when cloning is not possible
+    std::ifstream in(archive, std::ios::binary);
+    std::ofstream out(temp, std::ios::binary | (cloned ? std::ios::in : std::ios::trunc));
+    in.seekg(static_cast<std::streamoff>(offset + cloned));
+    out.seekp(static_cast<std::streamoff>(cloned));
+    std::vector<char> buffer(1 << 20);
+    for (uint64_t left = length - cloned; left > 0 && in && out;) {
+        size_t chunk = static_cast<size_t>(std::min<uint64_t>(left, buffer.size()));
+        in.read(buffer.data(), static_cast<std::streamsize>(chunk));
+        out.write(buffer.data(), in.gcount());
+        left -= static_cast<uint64_t>(in.gcount());
+        if (in.gcount() == 0) break;
+    }
+    out.close();
+
+    std::error_code ec;
+    if (!in || !out || util::fs::file_size(temp) != length) {
+        fs::remove(temp, ec);
+        throw std::runtime_error("Truncated cache archive " + archive);
+    }
+    if (!commit_blob(temp, dest, hash)) {
+        return Extracted::Rejected;
+    }
+    return cloned > 0 ? Extracted::Reflinked : Extracted::Copied;
+}
+
+// digests and keys only ever contain these, anything else from a server
+// must not end up in a path
+bool valid_name(const std::string& name) {
+    return name.size() >= 2 && std::all_of(name.begin(), name.end(),
+        [](unsigned char c) { return std::isalnum(c); });
+}
+
+// negative lookups against the remote, shared by every process on the
+// machine through a mapped file: "IRMF" reserved:u32 created:i64, then the
+// bits. a false positive only costs a remote hit, and the filter starts
+// over once it is MISS_FILTER_TTL old
+class MissFilter {
+public:
+    explicit MissFilter(const std::string& path) {
+#ifndef _WIN32
+        size_t size = MISS_FILTER_HEADER + MISS_FILTER_BITS / 8;
+        int fd = open(path.c_str(), O_RDWR);
+        if (fd >= 0 && !current(fd, size)) {
+            close(fd);
+            fd = -1;
+        }
+        if (fd < 0) {
+            // a fresh filter goes in through a rename so nobody maps it half
+            // written. two processes racing here each keep their own copy
+            std::string temp = path + ".tmp" + unique_suffix();
+            std::string header = std::string("IRMF") + std::string(4, '\0');
+            int64_t created = now_seconds();
+            header.append(reinterpret_cast<const char*>(&created), sizeof(created));
+            fd = open(temp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd >= 0 && (write(fd, header.data(), header.size()) != static_cast<ssize_t>(header.size()) ||
+                            ftruncate(fd, static_cast<off_t>(size)) != 0 ||
+                            std::rename(temp.c_str(), path.c_str()) != 0)) {
+                close(fd);
+                unlink(temp.c_str());
+                fd = -1;
+            }
+        }
+        if (fd >= 0) {
+            void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (map != MAP_FAILED) {
+                m_map = static_cast<unsigned char*>(map);
+                m_bits = m_map + MISS_FILTER_HEADER;
+                return;
+            }
+        }
+#else
+        (void)path;
+#endif
+        // not shared, still saves repeated lookups within this process
+        m_local.assign(MISS_FILTER_BITS / 8, 0);
+        m_bits = m_local.data();
+    }
+
+    ~MissFilter() {
+#ifndef _WIN32
+        if (m_map) {
+            munmap(m_map, MISS_FILTER_HEADER + MISS_FILTER_BITS / 8);
+        }
+#endif
+    }
+
+    MissFilter(const MissFilter&) = delete;
+    MissFilter& operator=(const MissFilter&) = delete;
+
+    bool contains(const std::string& key) const {
+        for (uint64_t bit : bits(key)) {
+#ifndef _WIN32
+            unsigned char byte = __atomic_load_n(&m_bits[bit / 8], __ATOMIC_RELAXED);
+#else
+            unsigned char byte = m_bits[bit / 8];
+#endif
+            if (!(byte & (1u << (bit % 8)))) return false;
+        }
+        return true;
+    }
+
+    void add(const std::string& key) {
+        for (uint64_t bit : bits(key)) {
+            unsigned char mask = static_cast<unsigned char>(1u << (bit % 8));
+#ifndef _WIN32
+            __atomic_fetch_or(&m_bits[bit / 8], mask, __ATOMIC_RELAXED);
+#else
+            m_bits[bit / 8] |= mask;
+#endif
+        }
+    }
+
+private:
+    unsigned char* m_map = nullptr;
+    unsigned char* m_bits = nullptr;
+    std::vector<unsigned char> m_local;
+
+    // double hashing, two 64 bit hashes give all the bit positions
+    static std::array<uint64_t, MISS_FILTER_HASHES> bits(const std::string& key) {
+        uint64_t a = util::hash::fast_hash(key);
+        uint64_t b = util::hash::fast_hash(key + "#") | 1;
+        std::array<uint64_t, MISS_FILTER_HASHES> result;
+        for (int i = 0; i < MISS_FILTER_HASHES; i++) {
+            result[i] = (a + i * b) % MISS_FILTER_BITS;
+        }
+        return result;
+    }
+
+#ifndef _WIN32
+    static bool current(int fd, size_t size) {
+        struct stat info;
+        unsigned char header[MISS_FILTER_HEADER];
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) != size ||
+            pread(fd, header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+            std::memcmp(header, "IRMF", 4) != 0) {
+            return false;
+        }
+        int64_t created;
+        std::memcpy(&created, header + 8, sizeof(created));
+        return now_seconds() - created < MISS_FILTER_TTL;
+    }
+#endif
+};
+
+} // namespace
+
+class RemoteCache {
+public:
+    RemoteCache(const std::string& url, const std::string& cache_dir)
+        : url(url), client(url), misses(cache_dir + "/remote-misses"),
+          down_marker(cache_dir + "/remote-down") {}
+
+    std::string url;
+    util::http::Client client;
+    MissFilter misses;
+
+    // set by a failed request, checked by everyone sharing the cache
+    bool down() const {
+        return util::fs::exists(down_marker) &&
+               now_seconds() - util::fs::modification_time(down_marker) < REMOTE_RETRY_DELAY;
+    }
+    void mark_down() const {
+        util::fs::write_file(down_marker, url + "\n");
+    }
+
+private:
+    std::string down_marker;
+};
+
+uint64_t CacheEntry::size() const {
+    uint64_t total = 0;
+    for (const auto& file : files) {
+        total += file.size;
+    }
+    return total;
+}
+
+Cache::Cache(const std::string& cache_dir) : m_cache_dir(cache_dir) {
+    fs::create_directories(m_cache_dir);
 }
 
 void Cache::set_cache_dir(const std::string& dir) {
@@ -26,118 +445,1006 @@ void Cache::set_cache_dir(const std::string& dir) {
     fs::create_directories(m_cache_dir);
 }
 
-bool Cache::is_up_to_date(const std::string& target,
-                          const std::string& input_hash,
-                          const std::string& command_hash) const {
-    auto it = m_entries.find(target);
-    if (it == m_entries.end()) {
+std::string Cache::get_manifest_path() const {
+    return m_cache_dir + "/manifest.json";
+}
+
+std::string Cache::get_journal_path() const {
+    return m_cache_dir + "/journal";
+}
+
+std::string Cache::get_lock_path() const {
+    return m_cache_dir + "/lock";
+}
+
+std::string Cache::ac_path(const std::string& key) const {
+    return m_cache_dir + "/ac/" + key.substr(0, 2) + "/" + key;
+}
+
+std::string Cache::cas_path(const std::string& hash) const {
+    return m_cache_dir + "/cas/" + hash.substr(0, 2) + "/" + hash;
+}
+
+std::string Cache::outbox_path() const {
+    return m_cache_dir + "/outbox";
+}
+
+void Cache::set_remote(const std::string& url) {
+    m_remote = url.empty() ? nullptr : std::make_shared<RemoteCache>(url, m_cache_dir);
+}
+
+uint64_t Cache::append(const std::string& record) {
+    CacheLock lock(get_lock_path(), LockMode::Shared);
+    std::string line = frame(record);
+
+#ifndef _WIN32
+    // one write per record, O_APPEND keeps concurrent records whole
+    int fd = open(get_journal_path().c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0) {
+        return 0;
+    }
+    ssize_t written = write(fd, line.data(), line.size());
+    (void)written;
+    struct stat info;
+    uint64_t size = fstat(fd, &info) == 0 ? static_cast<uint64_t>(info.st_size) : 0;
+    close(fd);
+    return size;
+#else
+    util::fs::append_file(get_journal_path(), line);
+    return util::fs::file_size(get_journal_path());
+#endif
+}
+
+// put <key> <created> <count> (<name> <hash> <size> <stored>)... <label>
+// hit <key> <time> <restored bytes> <restore micros>
+// miss
+// fetch <key> <bytes transferred>
+// del <key>
+void Cache::apply(const std::string& record) {
+    std::stringstream in(record);
+    std::string type, key;
+    in >> type;
+
+    if (type == "put") {
+        CacheEntry entry;
+        size_t count = 0;
+        in >> entry.key >> entry.created >> count;
+        for (size_t i = 0; i < count && in; i++) {
+            CachedFile file;
+            in >> file.name >> file.hash >> file.size >> file.stored;
+            entry.files.push_back(file);
+        }
+        std::getline(in >> std::ws, entry.label);
+        if (in.fail() && !in.eof()) {
+            return;
+        }
+        entry.last_access = entry.created;
+        m_entries[entry.key] = entry;
+    } else if (type == "hit") {
+        int64_t time = 0;
+        uint64_t bytes = 0;
+        uint64_t micros = 0;
+        in >> key >> time >> bytes >> micros;
+        m_hits++;
+        m_restored_bytes += bytes;
+        m_restore_micros += micros;
+        auto it = m_entries.find(key);
+        if (it != m_entries.end()) {
+            it->second.last_access = std::max(it->second.last_access, time);
+            it->second.hits++;
+        }
+    } else if (type == "miss") {
+        m_misses++;
+    } else if (type == "fetch") {
+        uint64_t bytes = 0;
+        in >> key >> bytes;
+        m_remote_hits++;
+        m_fetched_bytes += bytes;
+    } else if (type == "del") {
+        in >> key;
+        m_entries.erase(key);
+    }
+}
+
+bool Cache::restore(const std::string& key, const std::map<std::string, std::string>& outputs) {
+    // action entries and blobs are immutable once written, nothing to lock
+    auto read_entry = [&]() {
+        std::ifstream ac(ac_path(key));
+        std::map<std::string, std::string> blobs;
+        std::string line;
+
+        while (std::getline(ac, line)) {
+            std::stringstream fields(line);
+            std::string kind, name, hash;
+            fields >> kind;
+            if (kind == "file" && fields >> name >> hash) {
+                blobs[name] = hash;
+            }
+        }
+        return blobs;
+    };
+
+    auto blobs = read_entry();
+    if (blobs.empty() && m_remote && fetch(key)) {
+        blobs = read_entry();
+    }
+
+    bool found = !blobs.empty();
+    uint64_t restored = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (const auto& [name, path] : outputs) {
+        auto it = blobs.find(name);
+        if (!found || it == blobs.end() || !util::fs::exists(cas_path(it->second))) {
+            found = false;
+            break;
+        }
+        fs::create_directories(fs::path(path).parent_path());
+        try {
+            restored += util::compress::decompress_file(cas_path(it->second), path);
+        } catch (const std::exception&) {
+            found = false;
+            break;
+        }
+    }
+
+    if (!found) {
+        append("miss");
         return false;
     }
 
-    const auto& entry = it->second;
-    if (entry.input_hash != input_hash || entry.command_hash != command_hash) {
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    append("hit " + key + " " + std::to_string(now_seconds()) + " " +
+           std::to_string(restored) + " " + std::to_string(micros));
+    return true;
+}
+
+void Cache::store(const std::string& key,
+                  const std::string& label,
+                  const std::map<std::string, std::string>& files) {
+    const char* codec_env = std::getenv("IRIS_CACHE_COMPRESSION");
+    auto codec = codec_env && *codec_env ? util::compress::parse_codec(codec_env)
+                                         : util::compress::default_codec();
+
+    std::stringstream ac;
+    std::stringstream record;
+    record << "put " << key << " " << now_seconds() << " " << files.size();
+
+    for (const auto& [name, path] : files) {
+        std::string content = util::fs::read_file(path);
+        std::string hash = util::hash::sha256(content);
+
+        // identical outputs of different actions share one blob, keyed on
+        // the uncompressed contents whatever codec stored it
+        std::string blob = cas_path(hash);
+        if (!util::fs::exists(blob)) {
+            int level = util::compress::level_for_size(codec, content.size());
+            if (!write_atomic(blob, util::compress::compress(content, codec, level))) {
+                return;
+            }
+        }
+        uint64_t stored = util::fs::file_size(blob);
+
+        ac << "file " << name << " " << hash << " " << content.size() << "\n";
+        record << " " << name << " " << hash << " " << content.size() << " " << stored;
+    }
+    ac << "label " << label << "\n";
+    record << " " << label;
+
+    // the action entry goes first, a journaled entry is always restorable
+    if (!write_atomic(ac_path(key), ac.str())) {
+        return;
+    }
+
+    uint64_t journal_size = append(record.str());
+
+    // uploads happen later in push(), a store never waits for the network
+    if (m_remote) {
+        write_atomic(outbox_path() + "/" + key, "");
+    }
+
+    if (journal_size > COMPACT_THRESHOLD) {
+        compact(false);
+    }
+}
+
+bool Cache::contains(const std::string& key) const {
+    return util::fs::exists(ac_path(key));
+}
+
+bool Cache::fetch(const std::string& key) {
+    if (!m_remote || !valid_name(key) || m_remote->misses.contains(key) || m_remote->down()) {
         return false;
     }
 
-    // Check if outputs still exist
-    for (const auto& output : entry.outputs) {
-        if (!fs::exists(output)) {
+    try {
+        auto ac = m_remote->client.get("/ac/" + key);
+        if (ac.status == 404) {
+            m_remote->misses.add(key);
+            return false;
+        }
+        if (ac.status != 200) {
+            return false;
+        }
+
+        std::stringstream lines(ac.body);
+        std::string line;
+        uint64_t transferred = ac.body.size();
+
+        while (std::getline(lines, line)) {
+            std::stringstream fields(line);
+            std::string kind, name, hash;
+            uint64_t size = 0;
+            fields >> kind;
+            if (kind != "file") {
+                continue;
+            }
+            if (!(fields >> name >> hash >> size) || !valid_name(hash)) {
+                return false;
+            }
+
+            // blobs are checked against their digest before they go in, a
+            // broken server must not poison the local store
+            std::string blob = cas_path(hash);
+            if (!util::fs::exists(blob)) {
+                auto content = m_remote->client.get("/cas/" + hash);
+                if (content.status != 200) {
+                    return false;
+                }
+                transferred += content.body.size();
+
+                std::string temp = blob + ".tmp" + unique_suffix();
+                std::string check = temp + ".raw";
+                fs::create_directories(fs::path(blob).parent_path());
+                bool valid = false;
+                if (util::fs::write_file(temp, content.body)) {
+                    try {
+                        valid = util::compress::decompress_file(temp, check) == size &&
+                                util::hash::sha256(util::fs::read_file(check)) == hash;
+                    } catch (const std::exception&) {
+                    }
+                }
+                util::fs::remove_file(check);
+                std::error_code ec;
+                if (valid) {
+                    fs::rename(temp, blob, ec);
+                }
+                if (!valid || ec) {
+                    fs::remove(temp, ec);
+                    return false;
+                }
+            }
+        }
+
+        if (!install(key, ac.body)) {
             return false;
         }
+        append("fetch " + key + " " + std::to_string(transferred));
+        return true;
+    } catch (const std::exception&) {
+        m_remote->mark_down();
+        return false;
     }
+}
+
+bool Cache::install(const std::string& key, const std::string& entry) {
+    std::stringstream lines(entry);
+    std::stringstream record;
+    std::vector<std::string> files;
+    std::string label;
+    std::string line;
 
+    while (std::getline(lines, line)) {
+        std::stringstream fields(line);
+        std::string kind, name, hash;
+        uint64_t size = 0;
+        fields >> kind;
+        if (kind == "label") {
+            std::getline(fields >> std::ws, label);
+        } else if (kind == "file") {
+            if (!(fields >> name >> hash >> size) || !valid_name(hash) ||
+                !util::fs::exists(cas_path(hash))) {
+                return false;
+            }
+            files.push_back(name + " " + hash + " " + std::to_string(size) + " " +
+                            std::to_string(util::fs::file_size(cas_path(hash))));
+        }
+    }
+
+    if (files.empty() || !valid_name(key) || !write_atomic(ac_path(key), entry)) {
+        return false;
+    }
+
+    record << "put " << key << " " << now_seconds() << " " << files.size();
+    for (const auto& file : files) {
+        record << " " << file;
+    }
+    record << " " << label;
+    append(record.str());
     return true;
 }
 
-void Cache::store(const std::string& target,
-                  const std::string& input_hash,
-                  const std::string& command_hash,
-                  const std::vector<std::string>& outputs) {
-    CacheEntry entry;
-    entry.input_hash = input_hash;
-    entry.command_hash = command_hash;
-    entry.outputs = outputs;
-    entry.timestamp = std::chrono::duration_cast<std::chrono::seconds>(
-        std::chrono::system_clock::now().time_since_epoch()
-    ).count();
+size_t Cache::push(bool force) {
+    if (!m_remote || (!force && m_remote->down())) {
+        return 0;
+    }
 
-    m_entries[target] = entry;
-    m_dirty = true;
+    size_t uploaded = 0;
+    std::string outbox = outbox_path();
+    int64_t now = now_seconds();
+
+    for (const auto& name : util::fs::list_directory(outbox)) {
+        std::string path = outbox + "/" + name;
+        size_t dot = name.find('.');
+
+        // claimed by a pusher that went away without finishing, put it back
+        if (dot != std::string::npos) {
+            if (now - util::fs::modification_time(path) > ORPHAN_GRACE) {
+                std::rename(path.c_str(), (outbox + "/" + name.substr(0, dot)).c_str());
+            }
+            continue;
+        }
+
+        // the rename decides which of several pushers uploads an entry
+        std::string claimed = path + "." + unique_suffix();
+        if (std::rename(path.c_str(), claimed.c_str()) != 0) {
+            continue;
+        }
+        std::error_code ec;
+        fs::last_write_time(claimed, fs::file_time_type::clock::now(), ec);
+
+        if (!upload(name)) {
+            std::rename(claimed.c_str(), path.c_str());
+            m_remote->mark_down();
+            break;
+        }
+        util::fs::remove_file(claimed);
+        uploaded++;
+    }
+
+    return uploaded;
 }
 
-std::optional<CacheEntry> Cache::get(const std::string& target) const {
-    auto it = m_entries.find(target);
+bool Cache::upload(const std::string& key) {
+    std::string entry = util::fs::read_file(ac_path(key));
+    std::stringstream lines(entry);
+    std::string line;
+    bool any = false;
+
+    try {
+        while (std::getline(lines, line)) {
+            std::stringstream fields(line);
+            std::string kind, name, hash;
+            fields >> kind;
+            if (kind != "file" || !(fields >> name >> hash)) {
+                continue;
+            }
+            any = true;
+
+            // blobs are shared between actions, most are there already
+            if (m_remote->client.head("/cas/" + hash).status == 200) {
+                continue;
+            }
+            std::string blob = cas_path(hash);
+            if (!util::fs::exists(blob)) {
+                return true;  // evicted since, nothing to upload
+            }
+            int status = m_remote->client.put("/cas/" + hash, util::fs::read_file(blob)).status;
+            if (status < 200 || status >= 300) {
+                return false;
+            }
+        }
+
+        if (!any) {
+            return true;
+        }
+        int status = m_remote->client.put("/ac/" + key, entry).status;
+        return status >= 200 && status < 300;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+std::optional<CacheEntry> Cache::get(const std::string& key) const {
+    auto it = m_entries.find(key);
     if (it != m_entries.end()) {
         return it->second;
     }
     return std::nullopt;
 }
 
-void Cache::invalidate(const std::string& target) {
-    m_entries.erase(target);
-    m_dirty = true;
+uint64_t Cache::stored_bytes() const {
+    std::map<std::string, uint64_t> blobs;
+    for (const auto& [key, entry] : m_entries) {
+        for (const auto& file : entry.files) {
+            blobs[file.hash] = file.stored;
+        }
+    }
+
+    uint64_t total = 0;
+    for (const auto& [hash, size] : blobs) {
+        total += size;
+    }
+    return total;
 }
 
-void Cache::clear() {
-    m_entries.clear();
-    m_dirty = true;
+size_t Cache::evict(uint64_t max_bytes, int64_t max_age) {
+    std::vector<CacheEntry*> by_age;
+    for (auto& [key, entry] : m_entries) {
+        by_age.push_back(&entry);
+    }
+    std::sort(by_age.begin(), by_age.end(),
+        [](const CacheEntry* a, const CacheEntry* b) { return a->last_access < b->last_access; });
+
+    // blobs are shared between entries, so one only stops counting
+    // once its last user is evicted
+    std::map<std::string, int> refs;
+    for (const auto& [key, entry] : m_entries) {
+        for (const auto& file : entry.files) {
+            refs[file.hash]++;
+        }
+    }
+
+    // least recently used first, until both limits hold
+    std::set<std::string> freed;
+    size_t evicted = 0;
+    int64_t now = now_seconds();
+    uint64_t bytes = stored_bytes();
+
+    for (CacheEntry* entry : by_age) {
+        bool too_old = max_age > 0 && now - entry->last_access > max_age;
+        bool too_big = max_bytes > 0 && bytes > max_bytes;
+        if (!too_old && !too_big) {
+            continue;
+        }
+        for (const auto& file : entry->files) {
+            if (--refs[file.hash] == 0) {
+                bytes -= std::min(bytes, file.stored);
+                freed.insert(file.hash);
+            }
+        }
+        std::string key = entry->key;
+        std::error_code ec;
+        fs::remove(ac_path(key), ec);
+        m_entries.erase(key);
+        evicted++;
+    }
+
+    // drop files nothing refers to. orphans that never made it into the
+    // journal may belong to a store still in flight, so they get a grace
+    // period
+    auto sweep = [&](const std::string& dir, auto is_live) {
+        std::vector<fs::path> unused;
+        if (!fs::exists(dir)) return;
+        for (const auto& item : fs::recursive_directory_iterator(dir)) {
+            if (!item.is_regular_file()) continue;
+            std::string name = item.path().filename().string();
+            if (is_live(name)) continue;
+            if (!freed.count(name) &&
+                now - util::fs::modification_time(item.path().string()) < ORPHAN_GRACE) continue;
+            unused.push_back(item.path());
+        }
+        for (const auto& path : unused) {
+            std::error_code ec;
+            fs::remove(path, ec);
+        }
+    };
+
+    sweep(m_cache_dir + "/cas", [&](const std::string& hash) { return refs[hash] > 0; });
+    sweep(m_cache_dir + "/ac", [&](const std::string& key) { return m_entries.count(key) > 0; });
+
+    return evicted;
 }
 
-std::string Cache::get_manifest_path() const {
-    return m_cache_dir + "/manifest.json";
+size_t Cache::gc(uint64_t max_bytes, int64_t max_age) {
+    CacheLock lock(get_lock_path(), LockMode::Exclusive);
+    load();
+    size_t evicted = evict(max_bytes, max_age);
+    rewrite();
+    return evicted;
 }
 
-void Cache::load() {
-    std::string path = get_manifest_path();
-    if (!fs::exists(path)) {
-        return;
+bool Cache::compact(bool wait) {
+    CacheLock lock(get_lock_path(), wait ? LockMode::Exclusive : LockMode::TryExclusive);
+    if (!lock.held()) {
+        return false;
     }
+    load();
 
-    std::ifstream file(path);
-    // Simple JSON parsing (would use a proper library in production)
-    // For now, just load what we saved
-    std::string line;
-    std::string current_target;
-    
-    while (std::getline(file, line)) {
-        // Simplified parsing
-        if (line.find("\"target\":") != std::string::npos) {
-            size_t start = line.find(":") + 3;
-            size_t end = line.rfind("\"");
-            current_target = line.substr(start, end - start);
+    const char* size_env = std::getenv("IRIS_CACHE_MAX_SIZE");
+    const char* age_env = std::getenv("IRIS_CACHE_MAX_AGE");
+    uint64_t max_bytes = size_env ? parse_size(size_env) : parse_size("5G");
+    int64_t max_age = age_env ? parse_age(age_env) : 0;
+
+    // trim to 90% so the next few stores don't trigger another pass
+    bool over_size = max_bytes > 0 && stored_bytes() > max_bytes;
+    bool over_age = false;
+    if (max_age > 0) {
+        int64_t now = now_seconds();
+        over_age = std::any_of(m_entries.begin(), m_entries.end(),
+            [&](const auto& item) { return now - item.second.last_access > max_age; });
+    }
+    if (over_size || over_age) {
+        evict(max_bytes / 10 * 9, max_age);
+    }
+
+    rewrite();
+    return true;
+}
+
+CacheStats Cache::stats(size_t largest) const {
+    CacheStats stats;
+    stats.entries = m_entries.size();
+    stats.bytes = stored_bytes();
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.restored_bytes = m_restored_bytes;
+    stats.restore_micros = m_restore_micros;
+    stats.remote_hits = m_remote_hits;
+    stats.fetched_bytes = m_fetched_bytes;
+
+    std::map<std::string, uint64_t> raw;
+    for (const auto& [key, entry] : m_entries) {
+        for (const auto& file : entry.files) {
+            raw[file.hash] = file.size;
         }
-        // ... more parsing would go here
     }
+    for (const auto& [hash, size] : raw) {
+        stats.raw_bytes += size;
+    }
+
+    for (const auto& [key, entry] : m_entries) {
+        stats.largest.push_back(entry);
+    }
+    std::sort(stats.largest.begin(), stats.largest.end(),
+        [](const CacheEntry& a, const CacheEntry& b) { return a.size() > b.size(); });
+    if (stats.largest.size() > largest) {
+        stats.largest.resize(largest);
+    }
+
+    return stats;
+}
+
+void Cache::invalidate(const std::string& key) {
+    std::error_code ec;
+    fs::remove(ac_path(key), ec);
+    append("del " + key);
+    m_entries.erase(key);
 }
 
-void Cache::save() const {
-    std::ofstream file(get_manifest_path());
+void Cache::clear() {
+    CacheLock lock(get_lock_path(), LockMode::Exclusive);
+    m_entries.clear();
+    m_hits = 0;
+    m_misses = 0;
+    m_restored_bytes = 0;
+    m_restore_micros = 0;
+    m_remote_hits = 0;
+    m_fetched_bytes = 0;
+    fs::remove_all(m_cache_dir + "/ac");
+    fs::remove_all(m_cache_dir + "/cas");
+    rewrite();
+}
+
+void Cache::load() {
+    // a compaction renames the snapshot and then the journal. a reader that
+    // got the old snapshot and the new journal (or the other way round) sees
+    // mismatching ids and simply reads again
+    for (int attempt = 0;; attempt++) {
+        m_entries.clear();
+        m_hits = 0;
+        m_misses = 0;
+        m_restored_bytes = 0;
+        m_restore_micros = 0;
+        m_remote_hits = 0;
+        m_fetched_bytes = 0;
+
+        std::string snapshot_id;
+        std::string path = get_manifest_path();
+        if (fs::exists(path)) {
+            try {
+                util::json::Value doc = util::json::parse(util::fs::read_file(path));
+                snapshot_id = doc["journal"].as_string();
+                m_hits = static_cast<uint64_t>(doc["hits"].as_number());
+                m_misses = static_cast<uint64_t>(doc["misses"].as_number());
+                m_restored_bytes = static_cast<uint64_t>(doc["restored_bytes"].as_number());
+                m_restore_micros = static_cast<uint64_t>(doc["restore_micros"].as_number());
+                m_remote_hits = static_cast<uint64_t>(doc["remote_hits"].as_number());
+                m_fetched_bytes = static_cast<uint64_t>(doc["fetched_bytes"].as_number());
+
+                for (const auto& item : doc["entries"].array) {
+                    CacheEntry entry;
+                    entry.key = item["key"].as_string();
+                    entry.label = item["label"].as_string();
+                    entry.created = static_cast<int64_t>(item["created"].as_number());
+                    entry.last_access = static_cast<int64_t>(item["last_access"].as_number());
+                    entry.hits = static_cast<uint64_t>(item["hits"].as_number());
+                    for (const auto& file : item["files"].array) {
+                        CachedFile cached;
+                        cached.name = file["name"].as_string();
+                        cached.hash = file["hash"].as_string();
+                        cached.size = static_cast<uint64_t>(file["size"].as_number());
+                        cached.stored = file["stored"].is_null()
+                            ? cached.size : static_cast<uint64_t>(file["stored"].as_number());
+                        entry.files.push_back(cached);
+                    }
+                    if (!entry.key.empty()) {
+                        m_entries[entry.key] = entry;
+                    }
+                }
+            } catch (const std::exception&) {
+                // a damaged snapshot only costs the access history
+            }
+        }
+
+        std::ifstream journal(get_journal_path(), std::ios::binary);
+        std::vector<std::string> records;
+        std::string journal_id;
+        std::string line;
+        bool first = true;
+
+        while (std::getline(journal, line)) {
+            std::string record = unframe(line);
+            if (first && record.compare(0, 8, "journal ") == 0) {
+                journal_id = record.substr(8);
+            } else if (!record.empty()) {
+                records.push_back(record);
+            }
+            first = false;
+        }
+
+        // after a few tries the rotation was interrupted rather than in
+        // flight, replaying can then at worst count some hits twice
+        if (journal_id != snapshot_id && attempt < 5) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+
+        for (const auto& record : records) {
+            apply(record);
+        }
+        return;
+    }
+}
+
+void Cache::rewrite() {
+    using util::json::escape;
+
+    std::random_device random;
+    char id[17];
+    std::snprintf(id, sizeof(id), "%08x%08x", random(), random());
+
+    std::stringstream file;
     file << "{\n";
+    file << "  \"journal\": \"" << id << "\",\n";
+    file << "  \"hits\": " << m_hits << ",\n";
+    file << "  \"misses\": " << m_misses << ",\n";
+    file << "  \"restored_bytes\": " << m_restored_bytes << ",\n";
+    file << "  \"restore_micros\": " << m_restore_micros << ",\n";
+    file << "  \"remote_hits\": " << m_remote_hits << ",\n";
+    file << "  \"fetched_bytes\": " << m_fetched_bytes << ",\n";
     file << "  \"entries\": [\n";
 
     bool first = true;
-    for (const auto& [target, entry] : m_entries) {
+    for (const auto& [key, entry] : m_entries) {
         if (!first) file << ",\n";
         first = false;
 
         file << "    {\n";
-        file << "      \"target\": \"" << target << "\",\n";
-        file << "      \"input_hash\": \"" << entry.input_hash << "\",\n";
-        file << "      \"command_hash\": \"" << entry.command_hash << "\",\n";
-        file << "      \"timestamp\": " << entry.timestamp << ",\n";
-        file << "      \"outputs\": [";
-        
-        for (size_t i = 0; i < entry.outputs.size(); i++) {
+        file << "      \"key\": \"" << key << "\",\n";
+        file << "      \"label\": \"" << escape(entry.label) << "\",\n";
+        file << "      \"created\": " << entry.created << ",\n";
+        file << "      \"last_access\": " << entry.last_access << ",\n";
+        file << "      \"hits\": " << entry.hits << ",\n";
+        file << "      \"files\": [";
+
+        for (size_t i = 0; i < entry.files.size(); i++) {
             if (i > 0) file << ", ";
-            file << "\"" << entry.outputs[i] << "\"";
+            file << "{\"name\": \"" << escape(entry.files[i].name) << "\", "
+                 << "\"hash\": \"" << entry.files[i].hash << "\", "
+                 << "\"size\": " << entry.files[i].size << ", "
+                 << "\"stored\": " << entry.files[i].stored << "}";
         }
-        
+
         file << "]\n";
         file << "    }";
     }
 
     file << "\n  ]\n";
     file << "}\n";
+
+    // snapshot first: until the journal is replaced readers see mismatching
+    // ids and wait, nobody can append in between
+    if (write_atomic(get_manifest_path(), file.str())) {
+        write_atomic(get_journal_path(), frame(std::string("journal ") + id));
+    }
+}
+
+ArchiveStats Cache::export_archive(const std::string& path, int64_t since) const {
+    // entries whose files are all still there, blobs collected once
+    std::vector<std::pair<std::string, std::string>> actions;
+    std::set<std::string> blobs;
+    for (const auto& [key, entry] : m_entries) {
+        if (entry.last_access < since) {
+            continue;
+        }
+        bool complete = !entry.files.empty();
+        for (const auto& file : entry.files) {
+            complete = complete && util::fs::exists(cas_path(file.hash));
+        }
+        std::string text = util::fs::read_file(ac_path(key));
+        if (complete && !text.empty()) {
+            actions.emplace_back(key, text);
+            for (const auto& file : entry.files) {
+                blobs.insert(file.hash);
+            }
+        }
+    }
+
+    std::ofstream file;
+    std::ostream* out = &std::cout;
+    if (path != "-") {
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error("Cannot write " + path);
+        }
+        out = &file;
+    }
+
+    ArchiveStats stats;
+    std::string index;
+    uint64_t offset = 0;
+
+    auto write_record = [&](char kind, const std::string& name, const std::string& data) {
+        std::string header(1, kind);
+        put_le(header, name.size(), 2);
+        put_le(header, data.size(), 8);
+        header += name;
+        out->write(header.data(), static_cast<std::streamsize>(header.size()));
+        out->write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (kind == 'b' || kind == 'a') {
+            index += std::string(1, kind) + " " + name + " " +
+                     std::to_string(offset + header.size()) + " " + std::to_string(data.size()) + "\n";
+        }
+        offset += header.size() + data.size();
+    };
+
+    out->write(ARCHIVE_MAGIC, 8);
+    offset = 8;
+
+    for (const auto& hash : blobs) {
+        std::string data = util::fs::read_file(cas_path(hash));
+        if (data.size() >= REFLINK_MIN) {
+            uint64_t start = offset + RECORD_HEADER + hash.size();
+            uint64_t pad = (REFLINK_ALIGN - start % REFLINK_ALIGN) % REFLINK_ALIGN;
+            if (pad > 0 && pad < RECORD_HEADER) {
+                pad += REFLINK_ALIGN;
+            }
+            if (pad > 0) {
+                write_record('p', "", std::string(pad - RECORD_HEADER, '\0'));
+            }
+        }
+        write_record('b', hash, data);
+        stats.blobs++;
+        stats.bytes += data.size();
+    }
+    for (const auto& [key, text] : actions) {
+        write_record('a', key, text);
+        stats.entries++;
+    }
+
+    uint64_t index_offset = offset;
+    write_record('i', "", index);
+    std::string trailer;
+    put_le(trailer, index_offset, 8);
+    trailer.append(ARCHIVE_END, 8);
+    out->write(trailer.data(), static_cast<std::streamsize>(trailer.size()));
+    out->flush();
+
+    if (!*out) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+    return stats;
+}
+
+ArchiveStats Cache::import_archive(const std::string& path) {
+    ArchiveStats stats;
+    std::vector<std::pair<std::string, std::string>> actions;
+
+    if (path == "-") {
+        // a stream has no index to jump to, take the records as they come
+        std::istream& in = std::cin;
+        std::string magic(8, '\0');
+        if (!in.read(&magic[0], 8) || magic != ARCHIVE_MAGIC) {
+            throw std::runtime_error("Not a cache archive");
+        }
+        for (;;) {
+            std::string header(RECORD_HEADER, '\0');
+            if (!in.read(&header[0], RECORD_HEADER)) {
+                throw std::runtime_error("Truncated cache archive");
+            }
+            char kind = header[0];
+            std::string name(get_le(header, 1, 2), '\0');
+            std::string data(get_le(header, 3, 8), '\0');
+            if (!in.read(&name[0], static_cast<std::streamsize>(name.size())) ||
+                !in.read(&data[0], static_cast<std::streamsize>(data.size()))) {
+                throw std::runtime_error("Truncated cache archive");
+            }
+            if (kind == 'i') {
+                break;
+            }
+            if (kind == 'b' && valid_name(name)) {
+                std::string blob = cas_path(name);
+                if (!util::fs::exists(blob)) {
+                    std::string temp = blob + ".tmp" + unique_suffix();
+                    fs::create_directories(fs::path(blob).parent_path());
+                    if (!util::fs::write_file(temp, data) || !commit_blob(temp, blob, name)) {
+                        stats.rejected++;
+                        continue;
+                    }
+                }
+                stats.blobs++;
+                stats.bytes += data.size();
+            } else if (kind == 'a') {
+                actions.emplace_back(name, data);
+            }
+        }
+    } else {
+        std::ifstream in(path, std::ios::binary);
+        uint64_t size = util::fs::file_size(path);
+        std::string magic(8, '\0');
+        std::string trailer(ARCHIVE_TRAILER, '\0');
+        if (!in || size < 8 + ARCHIVE_TRAILER || !in.read(&magic[0], 8) || magic != ARCHIVE_MAGIC) {
+            throw std::runtime_error("Not a cache archive: " + path);
+        }
+        in.seekg(static_cast<std::streamoff>(size - ARCHIVE_TRAILER));
+        if (!in.read(&trailer[0], ARCHIVE_TRAILER) || trailer.compare(8, 8, ARCHIVE_END) != 0) {
+            throw std::runtime_error("Truncated cache archive " + path);
+        }
+
+        uint64_t index_offset = get_le(trailer, 0, 8);
+        std::string header(RECORD_HEADER, '\0');
+        in.seekg(static_cast<std::streamoff>(index_offset));
+        if (index_offset >= size || !in.read(&header[0], RECORD_HEADER) || header[0] != 'i') {
+            throw std::runtime_error("Damaged cache archive " + path);
+        }
+        std::string index(get_le(header, 3, 8), '\0');
+        in.seekg(static_cast<std::streamoff>(get_le(header, 1, 2)), std::ios::cur);
+        if (!in.read(&index[0], static_cast<std::streamsize>(index.size()))) {
+            throw std::runtime_error("Damaged cache archive " + path);
+        }
+
+        struct Member {
+            std::string name;
+            uint64_t offset;
+            uint64_t length;
+        };
+        std::vector<Member> blobs;
+        std::vector<Member> entries;
+        std::stringstream lines(index);
+        std::string line;
+        while (std::getline(lines, line)) {
+            std::stringstream fields(line);
+            std::string kind;
+            Member member;
+            if (!(fields >> kind >> member.name >> member.offset >> member.length) ||
+                member.offset + member.length > index_offset || !valid_name(member.name)) {
+                throw std::runtime_error("Damaged cache archive " + path);
+            }
+            (kind == "b" ? blobs : entries).push_back(member);
+        }
+
+        // blobs are independent files, extract them side by side
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> reflinked{0};
+        std::vector<char> rejected(blobs.size(), 0);
+        std::vector<std::thread> workers;
+        std::vector<std::string> errors;
+        std::mutex error_mutex;
+        size_t threads = std::max(1u, std::min(std::thread::hardware_concurrency(), 16u));
+
+        for (size_t t = 0; t < threads && t < blobs.size(); t++) {
+            workers.emplace_back([&]() {
+                for (size_t i; (i = next++) < blobs.size();) {
+                    const auto& blob = blobs[i];
+                    try {
+                        if (util::fs::exists(cas_path(blob.name))) {
+                            continue;
+                        }
+                        switch (extract(path, blob.offset, blob.length, cas_path(blob.name), blob.name)) {
+                            case Extracted::Reflinked: reflinked++; break;
+                            case Extracted::Rejected: rejected[i] = 1; break;
+                            case Extracted::Copied: break;
+                        }
+                    } catch (const std::exception& e) {
+                        std::lock_guard<std::mutex> lock(error_mutex);
+                        errors.push_back(e.what());
+                    }
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        if (!errors.empty()) {
+            throw std::runtime_error(errors.front());
+        }
+
+        for (size_t i = 0; i < blobs.size(); i++) {
+            if (rejected[i]) {
+                stats.rejected++;
+            } else {
+                stats.blobs++;
+                stats.bytes += blobs[i].length;
+            }
+        }
+        stats.reflinked = reflinked;
+
+        for (const auto& entry : entries) {
+            std::string text(entry.length, '\0');
+            in.seekg(static_cast<std::streamoff>(entry.offset));
+            if (!in.read(&text[0], static_cast<std::streamsize>(text.size()))) {
+                throw std::runtime_error("Damaged cache archive " + path);
+            }
+            actions.emplace_back(entry.name, text);
+        }
+    }
+
+    // entries go in after their blobs, like a store. install() turns down
+    // any entry that refers to a rejected blob
+    for (const auto& [key, text] : actions) {
+        if (install(key, text)) {
+            stats.entries++;
+        }
+    }
+    compact(false);
+    return stats;
+}
+
+uint64_t parse_size(const std::string& text) {
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    uint64_t unit = 1;
+
+    switch (end && *end ? std::toupper(static_cast<unsigned char>(*end)) : 0) {
+        case 'K': unit = 1ull << 10; break;
+        case 'M': unit = 1ull << 20; break;
+        case 'G': unit = 1ull << 30; break;
+        case 'T': unit = 1ull << 40; break;
+        default: break;
+    }
+    return static_cast<uint64_t>(value * unit);
+}
+
+int64_t parse_age(const std::string& text) {
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    int64_t unit = 1;
+
+    switch (end && *end ? *end : 0) {
+        case 'm': unit = 60; break;
+        case 'h': unit = 3600; break;
+        case 'd': unit = 86400; break;
+        case 'w': unit = 7 * 86400; break;
+        default: break;
+    }
+    return static_cast<int64_t>(value * unit);
+}
+
+std::string format_size(uint64_t bytes) {
+    const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+    double value = static_cast<double>(bytes);
+    int unit = 0;
+    while (value >= 1024.0 && unit < 4) {
+        value /= 1024.0;
+        unit++;
+    }
+
+    std::ostringstream out;
+    out.precision(unit == 0 ? 0 : 1);
+    out << std::fixed << value << " " << units[unit];
+    return out.str();
 }
 
-} // namespace iris::core
\ No newline at end of file
+} // namespace iris::core
@@ -4,46 +4,180 @@
 #include <vector>
 #include <map>
 #include <optional>
+#include <memory>
+#include <cstdint>
 
 namespace iris::core {
 
+// one file of a cached action, stored once per content hash
+struct CachedFile {
+    std::string name;     // role within the action, e.g. "object" or "depfile"
+    std::string hash;     // of the uncompressed contents
+    uint64_t size = 0;
+    uint64_t stored = 0;  // bytes on disk after compression
+};
+
 struct CacheEntry {
-    std::string input_hash;
-    std::string command_hash;
-    std::vector<std::string> outputs;
-    int64_t timestamp;
+    std::string key;
+    std::string label;         // output path it was stored for, for display
+    std::vector<CachedFile> files;
+    int64_t created = 0;
+    int64_t last_access = 0;   // tracked in the journal, not via atime
+    uint64_t hits = 0;
+
+    uint64_t size() const;
 };
 
+struct CacheStats {
+    size_t entries = 0;
+    uint64_t bytes = 0;        // unique blob bytes on disk
+    uint64_t raw_bytes = 0;    // the same blobs uncompressed
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t restored_bytes = 0;   // written by hits, with the time it took
+    uint64_t restore_micros = 0;
+    uint64_t remote_hits = 0;      // entries fetched from the remote cache
+    uint64_t fetched_bytes = 0;    // as transferred, i.e. compressed
+    std::vector<CacheEntry> largest;
+};
+
+// result of exporting or importing an archive
+struct ArchiveStats {
+    size_t entries = 0;
+    size_t blobs = 0;        // unique blobs, each stored once
+    uint64_t bytes = 0;      // blob bytes as stored, i.e. compressed
+    size_t reflinked = 0;    // imported blobs cloned instead of copied
+    size_t rejected = 0;     // imported blobs that did not match their digest
+};
+
+class RemoteCache;
+
+// content addressed build cache, shared by any number of processes:
+//   <dir>/ac/<xx>/<key>    action entries, one "name hash size" line per file
+//   <dir>/cas/<xx>/<hash>  file contents, compressed (see util/compress)
+//   <dir>/journal          append-only log of stores, hits and evictions
+//   <dir>/manifest.json    snapshot the journal is folded into by compaction
+//
+// every change is a single checksummed O_APPEND write to the journal, taken
+// under a shared lock so writers never wait for each other. compaction and gc
+// hold the lock exclusively while they rewrite the snapshot and start a new
+// journal. readers take no lock at all: the snapshot names the journal it
+// was written with and a reader that catches the two mid rotation retries.
+//
+// a remote http cache can sit behind it (see set_remote), it speaks
+// GET/PUT/HEAD on <url>/ac/<key> and <url>/cas/<hash> with the same
+// contents as the files above
 class Cache {
 public:
     Cache(const std::string& cache_dir = ".iris-cache");
-    ~Cache();
+    ~Cache() = default;
 
     void set_cache_dir(const std::string& dir);
+    const std::string& cache_dir() const { return m_cache_dir; }
+
+    // "http://host[:port][/prefix]". restores that miss locally then try
+    // the remote and stores are queued for upload by push()
+    void set_remote(const std::string& url);
+    bool has_remote() const { return m_remote != nullptr; }
+
+    // restores the files of a cached action, name -> destination path.
+    // returns false (and logs a miss) when the key is unknown or a file is
+    // missing from the store
+    bool restore(const std::string& key, const std::map<std::string, std::string>& outputs);
+
+    // stores the given files (name -> path) under key, compressed with
+    // IRIS_CACHE_COMPRESSION (lz, zstd or none; zstd when built in)
+    void store(const std::string& key,
+               const std::string& label,
+               const std::map<std::string, std::string>& files);
 
-    bool is_up_to_date(const std::string& target,
-                       const std::string& input_hash,
-                       const std::string& command_hash) const;
+    // whether the action entry is in the local store
+    bool contains(const std::string& key) const;
 
-    void store(const std::string& target,
-               const std::string& input_hash,
-               const std::string& command_hash,
-               const std::vector<std::string>& outputs);
+    // copies an action and its blobs from the remote into the local store.
+    // keys the remote did not have are kept in a bloom filter shared by all
+    // processes and not asked for again for a while. false on a miss or when
+    // the remote cannot be reached
+    bool fetch(const std::string& key);
 
-    std::optional<CacheEntry> get(const std::string& target) const;
+    // uploads the entries queued since the last push, blobs before the
+    // action so the remote never serves an entry it cannot restore. any
+    // number of threads and processes may push at once, each entry is
+    // claimed by one of them. after a failed request the remote is left
+    // alone for a minute unless force is given. returns the number uploaded
+    size_t push(bool force = false);
 
-    void invalidate(const std::string& target);
+    // writes the entries stored or hit at or after since (0 for all) into a
+    // single archive, "-" for stdout. blobs shared between entries go in
+    // once. needs load()
+    ArchiveStats export_archive(const std::string& path, int64_t since = 0) const;
+
+    // adds the entries of an archive. blobs are extracted by several threads
+    // and reflinked out of the archive where the filesystem supports it,
+    // "-" reads a stream from stdin one record at a time instead. blobs are
+    // checked against their digest, a mismatch rejects the blob and every
+    // entry using it. throws std::runtime_error on a damaged archive
+    ArchiveStats import_archive(const std::string& path);
+
+    // lookups and stats see the state as of the last load()
+    std::optional<CacheEntry> get(const std::string& key) const;
+    CacheStats stats(size_t largest = 10) const;
+
+    // evicts least recently used entries until the cache holds at most
+    // max_bytes and nothing older than max_age seconds (0 disables either).
+    // returns the number of entries removed
+    size_t gc(uint64_t max_bytes, int64_t max_age = 0);
+
+    // folds the journal into the snapshot, trimming the cache to the limits
+    // from IRIS_CACHE_MAX_SIZE / IRIS_CACHE_MAX_AGE (default 5G, no age limit)
+    // on the way. without wait it gives up when another process holds the
+    // lock and returns false. stores run it once the journal grows large
+    bool compact(bool wait = true);
+
+    void invalidate(const std::string& key);
     void clear();
 
+    // reads the snapshot and replays the journal on top
     void load();
-    void save() const;
 
 private:
     std::string m_cache_dir;
     std::map<std::string, CacheEntry> m_entries;
-    bool m_dirty = false;
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+    uint64_t m_restored_bytes = 0;
+    uint64_t m_restore_micros = 0;
+    uint64_t m_remote_hits = 0;
+    uint64_t m_fetched_bytes = 0;
+    std::shared_ptr<RemoteCache> m_remote;
 
     std::string get_manifest_path() const;
+    std::string get_journal_path() const;
+    std::string get_lock_path() const;
+    std::string ac_path(const std::string& key) const;
+    std::string cas_path(const std::string& hash) const;
+    std::string outbox_path() const;
+    uint64_t stored_bytes() const;  // on disk, shared blobs counted once
+
+    // appends one record to the journal, returns the journal's size after it
+    uint64_t append(const std::string& record);
+    void apply(const std::string& record);
+
+    // uploads one queued entry, false when the remote failed
+    bool upload(const std::string& key);
+
+    // journals an action entry whose blobs are all in place, false if not
+    bool install(const std::string& key, const std::string& entry);
+
+    // eviction and snapshot rewrite, the caller holds the exclusive lock
+    size_t evict(uint64_t max_bytes, int64_t max_age);
+    void rewrite();
 };
 
-} // namespace iris::core
\ No newline at end of file
+// "5G", "512M", "64K" or plain bytes
+uint64_t parse_size(const std::string& text);
+// "30d", "12h", "15m" or plain seconds
+int64_t parse_age(const std::string& text);
+std::string format_size(uint64_t bytes);
+
+} // namespace iris::core
@@ -0,0 +1,991 @@
+#include "compile.hpp"
+#include "cache.hpp"
+#include "../util/fs.hpp"
+#include "../util/hash.hpp"
+#include "../util/tokens.hpp"
+
+#include <fstream>
+#include <filesystem>
+#include <iostream>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cstdint>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace iris::core {
+
+namespace {
+
+int run_command(const std::vector<std::string>& args, const std::string& cwd = "") {
+    std::vector<char*> argv;
+    for (const auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+#ifdef _WIN32
+    std::string previous = cwd.empty() ? "" : util::fs::current_path();
+    if (!cwd.empty()) util::fs::set_current_path(cwd);
+    int result = static_cast<int>(_spawnvp(_P_WAIT, argv[0], argv.data()));
+    if (!cwd.empty()) util::fs::set_current_path(previous);
+    return result;
+#else
+    // exec directly so diagnostics reach the build tool unchanged
+    pid_t pid = fork();
+    if (pid < 0) {
+        throw std::runtime_error("Failed to start " + args[0]);
+    }
+    if (pid == 0) {
+        if (!cwd.empty() && chdir(cwd.c_str()) != 0) {
+            std::perror(cwd.c_str());
+            _exit(127);
+        }
+        execvp(argv[0], argv.data());
+        std::perror(argv[0]);
+        _exit(127);
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+#endif
+}
+
+bool same_contents(const std::string& a, const std::string& b) {
+    if (util::fs::file_size(a) != util::fs::file_size(b)) {
+        return false;
+    }
+
+    std::ifstream fa(a, std::ios::binary);
+    std::ifstream fb(b, std::ios::binary);
+    char ba[65536];
+    char bb[65536];
+
+    while (fa && fb) {
+        fa.read(ba, sizeof(ba));
+        fb.read(bb, sizeof(bb));
+        if (fa.gcount() != fb.gcount() ||
+            !std::equal(ba, ba + fa.gcount(), bb)) {
+            return false;
+        }
+    }
+    return fa.eof() && fb.eof();
+}
+
+// moves a fresh output into place unless it matches the existing one
+void keep_or_replace(const std::string& temp, const std::string& output) {
+    if (util::fs::exists(output) && same_contents(temp, output)) {
+        util::fs::remove_file(temp);
+        util::fs::append_file(CUTOFF_LOG, output + "\n");
+    } else if (std::rename(temp.c_str(), output.c_str()) != 0) {
+        throw std::runtime_error("Cannot replace " + output);
+    }
+}
+
+// rewrites relative paths in include style flags, separate ("-I dir") or
+// joined ("-Idir", "-isystemdir"), for a compiler running in another
+// directory
+std::vector<std::string> absolute_paths(const std::vector<std::string>& args) {
+    static const std::vector<std::string> path_flags = {
+        "-include-pch", "-include", "-imacros", "-isystem", "-iquote", "-idirafter", "-I"
+    };
+
+    auto absolute = [](const std::string& path) {
+        return fs::path(path).is_absolute() ? path : fs::absolute(path).lexically_normal().string();
+    };
+
+    std::vector<std::string> result;
+    for (size_t i = 0; i < args.size(); i++) {
+        const std::string& arg = args[i];
+        bool done = false;
+
+        for (const auto& flag : path_flags) {
+            if (arg == flag && i + 1 < args.size()) {
+                result.push_back(arg);
+                result.push_back(absolute(args[++i]));
+                done = true;
+            } else if (arg.size() > flag.size() && arg.compare(0, flag.size(), flag) == 0 &&
+                       arg != "-I-") {
+                result.push_back(flag + absolute(arg.substr(flag.size())));
+                done = true;
+            }
+            if (done) break;
+        }
+
+        if (!done) result.push_back(arg);
+    }
+    return result;
+}
+
+// the value following a flag like -o or -MF, empty when absent
+std::string flag_value(const std::vector<std::string>& args, const std::string& flag) {
+    for (size_t i = 0; i + 1 < args.size(); i++) {
+        if (args[i] == flag) return args[i + 1];
+    }
+    return "";
+}
+
+// compiler identity for cache keys: the resolved driver and a hash of its
+// contents, so an upgrade in place changes the key but the install time or
+// machine does not
+std::string compiler_identity(const std::string& compiler) {
+    std::string path = compiler;
+    if (compiler.find('/') == std::string::npos) {
+        const char* env = std::getenv("PATH");
+        std::stringstream dirs(env ? env : "");
+        std::string dir;
+        while (std::getline(dirs, dir, ':')) {
+            if (!dir.empty() && util::fs::is_file(dir + "/" + compiler)) {
+                path = dir + "/" + compiler;
+                break;
+            }
+        }
+    }
+    return path + " " + util::hash::hash_file(path);
+}
+
+// rewrites paths under the build dir and the source root to placeholders,
+// so keys and cached depfiles are the same in every checkout
+class PathMap {
+public:
+    PathMap(const std::string& source_root, const std::string& build_dir)
+        : m_source(canonical(source_root)), m_build(canonical(build_dir)) {}
+
+    std::string normalize(const std::string& path) const {
+        if (path.empty() || path.find('\\') != std::string::npos) {
+            return path;
+        }
+        fs::path full = fs::path(path).is_absolute() ? fs::path(path) : fs::path(m_build) / path;
+        std::string normal = full.lexically_normal().generic_string();
+
+        // the build dir usually sits inside the source tree, try it first
+        if (under(normal, m_build)) return "@BUILD@" + normal.substr(m_build.size());
+        if (under(normal, m_source)) return "@SOURCE@" + normal.substr(m_source.size());
+        return normal;
+    }
+
+    const std::string& source() const { return m_source; }
+
+    // back to paths relative to the build dir
+    std::string expand(const std::string& path) const {
+        if (path.compare(0, 7, "@BUILD@") == 0) {
+            std::string rest = path.substr(7);
+            if (!rest.empty() && rest[0] == '/') rest.erase(0, 1);
+            return rest.empty() ? "." : rest;
+        }
+        if (path.compare(0, 8, "@SOURCE@") == 0 && !m_source.empty()) {
+            std::string root = fs::path(m_source).lexically_relative(m_build).generic_string();
+            return (root.empty() ? "." : root) + path.substr(8);
+        }
+        return path;
+    }
+
+    // whether both roots are remapped by -ffile-prefix-map or
+    // -fdebug-prefix-map, which keeps them out of debug info
+    bool remapped(const std::vector<std::string>& args) const {
+        bool source = m_source.empty();
+        bool build = false;
+        for (const auto& arg : args) {
+            for (const char* flag : {"-ffile-prefix-map=", "-fdebug-prefix-map="}) {
+                size_t length = std::char_traits<char>::length(flag);
+                if (arg.compare(0, length, flag) != 0) continue;
+                std::string old = normalize(arg.substr(length, arg.find('=', length) - length));
+                if (old.compare(0, 7, "@BUILD@") == 0 && old.size() <= 8) build = true;
+                if (old.compare(0, 8, "@SOURCE@") == 0 && old.size() <= 9) source = build = true;
+            }
+        }
+        return source && build;
+    }
+
+private:
+    std::string m_source;
+    std::string m_build;
+
+    static std::string canonical(const std::string& path) {
+        if (path.empty()) return path;
+        std::error_code ec;
+        std::string result = fs::weakly_canonical(path, ec).generic_string();
+        if (ec) result = fs::absolute(path).lexically_normal().generic_string();
+        while (result.size() > 1 && result.back() == '/') result.pop_back();
+        return result;
+    }
+
+    static bool under(const std::string& path, const std::string& root) {
+        return !root.empty() && path.compare(0, root.size(), root) == 0 &&
+               (path.size() == root.size() || path[root.size()] == '/');
+    }
+};
+
+// compiler arguments with paths normalized and the ordering that does not
+// change the result made canonical: repeated include dirs are dropped (the
+// compiler ignores them) and runs of defines for distinct macros are sorted
+std::vector<std::string> normalize_args(const std::vector<std::string>& args, const PathMap& paths) {
+    static const std::vector<std::string> path_flags = {
+        "-include-pch", "-include", "-imacros", "-isystem", "-iquote", "-idirafter",
+        "-isysroot", "--sysroot", "-I"
+    };
+    static const std::vector<std::string> map_flags = {
+        "-ffile-prefix-map=", "-fdebug-prefix-map=", "-fmacro-prefix-map=", "-fprofile-prefix-map="
+    };
+
+    std::vector<std::string> result;
+    std::set<std::string> includes;
+
+    for (size_t i = 0; i < args.size(); i++) {
+        const std::string& arg = args[i];
+        std::string normal = arg;
+
+        if (arg == "-c" && i + 1 < args.size()) {
+            result.push_back(arg);
+            result.push_back(paths.normalize(args[++i]));
+            continue;
+        }
+        if (std::find(path_flags.begin(), path_flags.end(), arg) != path_flags.end() &&
+            i + 1 < args.size()) {
+            result.push_back(arg);
+            result.push_back(paths.normalize(args[++i]));
+            continue;
+        }
+        if (arg.size() > 2 && arg.compare(0, 2, "-I") == 0) {
+            normal = "-I" + paths.normalize(arg.substr(2));
+            if (!includes.insert(normal).second) continue;
+        }
+        for (const auto& flag : map_flags) {
+            if (arg.compare(0, flag.size(), flag) == 0) {
+                size_t eq = arg.find('=', flag.size());
+                if (eq != std::string::npos) {
+                    normal = flag + paths.normalize(arg.substr(flag.size(), eq - flag.size())) +
+                             arg.substr(eq);
+                }
+            }
+        }
+        result.push_back(normal);
+    }
+
+    auto is_define = [](const std::string& arg) {
+        return arg.size() > 2 && (arg.compare(0, 2, "-D") == 0 || arg.compare(0, 2, "-U") == 0);
+    };
+    auto macro = [](const std::string& arg) {
+        return arg.substr(2, arg.find_first_of("=(", 2) - 2);
+    };
+
+    for (size_t begin = 0; begin < result.size();) {
+        size_t end = begin;
+        std::set<std::string> names;
+        bool distinct = true;
+        while (end < result.size() && is_define(result[end])) {
+            distinct = names.insert(macro(result[end])).second && distinct;
+            end++;
+        }
+        if (end - begin > 1 && distinct) {
+            std::sort(result.begin() + begin, result.begin() + end);
+        }
+        begin = std::max(end, begin + 1);
+    }
+
+    return result;
+}
+
+// preprocessed source with the paths in its line markers normalized.
+// anything else (__FILE__ included) is left alone since it ends up in the
+// object as written
+std::string normalize_markers(const std::string& text, const PathMap& paths) {
+    std::string result;
+    result.reserve(text.size());
+    size_t pos = 0;
+
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos) end = text.size();
+
+        size_t open = text.find('"', pos);
+        size_t close = open < end ? text.rfind('"', end) : std::string::npos;
+        bool marker = end - pos > 3 && text[pos] == '#' && text[pos + 1] == ' ' &&
+                      std::isdigit(static_cast<unsigned char>(text[pos + 2])) &&
+                      close != std::string::npos && close > open;
+
+        if (marker) {
+            result.append(text, pos, open + 1 - pos);
+            result += paths.normalize(text.substr(open + 1, close - open - 1));
+            result.append(text, close, end - close);
+        } else {
+            result.append(text, pos, end - pos);
+        }
+        result += '\n';
+        pos = end + 1;
+    }
+    return result;
+}
+
+// gcc's -dU lists every macro the preprocessor expanded or tested, as a
+// "#define" or "#undef" line at the point of use. clang ignores it
+bool lists_macros(const std::string& compiler) {
+    return fs::path(compiler).filename().string().find("clang") == std::string::npos;
+}
+
+// takes the -dU lines out of preprocessed text and returns their macros
+std::set<std::string> take_macro_lines(std::string& text) {
+    std::set<std::string> macros;
+    std::string rest;
+    rest.reserve(text.size());
+    size_t pos = 0;
+
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        end = end == std::string::npos ? text.size() : end + 1;
+        size_t name = text.compare(pos, 8, "#define ") == 0 ? pos + 8
+                    : text.compare(pos, 7, "#undef ") == 0 ? pos + 7 : std::string::npos;
+        if (name == std::string::npos) {
+            rest.append(text, pos, end - pos);
+        } else {
+            size_t stop = text.find_first_of("( \t\r\n", name);
+            macros.insert(text.substr(name, std::min(stop, end) - name));
+        }
+        pos = end;
+    }
+    text.swap(rest);
+    return macros;
+}
+
+// key of a single source compile run in cwd: compiler, flags and
+// preprocessed source. empty when the command cannot be cached. macros, when
+// given, receives what the source's preprocessing used (empty if unknown)
+std::string action_key(const std::string& output,
+                       const std::vector<std::string>& command,
+                       const PathMap& paths,
+                       const std::string& cwd,
+                       std::set<std::string>* macros = nullptr) {
+    auto in_cwd = [&](const std::string& path) {
+        return fs::path(path).is_absolute() ? path : cwd + "/" + path;
+    };
+
+    std::string key = "iris-cache-3\n" + compiler_identity(command[0]) + "\n";
+    std::vector<std::string> preprocess;
+    std::vector<std::string> flags;
+    bool has_source = false;
+    bool debug = false;
+
+    for (size_t i = 0; i < command.size(); i++) {
+        const std::string& arg = command[i];
+
+        // outputs do not change what gets compiled
+        if ((arg == "-o" || arg == "-MF" || arg == "-MT" || arg == "-MQ") && i + 1 < command.size()) {
+            i++;
+            continue;
+        }
+        // module imports are not part of the preprocessed text
+        if (arg == "-fmodules-ts" || arg == "-fmodules" ||
+            arg.compare(0, 14, "-fmodule-file=") == 0 || arg.compare(0, 16, "-fmodule-mapper=") == 0) {
+            return "";
+        }
+        // a clang pch is binary and not expanded by -E, hash it instead
+        if (arg == "-include-pch" && i + 1 < command.size()) {
+            key += "pch " + util::hash::hash_file(in_cwd(command[i + 1]), "sha256") + "\n";
+        }
+        if (arg.compare(0, 2, "-g") == 0 && arg != "-g0") {
+            debug = true;
+        }
+
+        if (arg == "-c") {
+            has_source = true;
+        } else if (arg != "-MMD" && arg != "-MD") {
+            preprocess.push_back(arg);
+        }
+        if (i > 0) {
+            flags.push_back(arg);
+        }
+    }
+
+    if (!has_source) {
+        return "";
+    }
+
+    for (const auto& arg : normalize_args(flags, paths)) {
+        key += arg + "\n";
+    }
+
+    // debug info records absolute paths unless both roots are remapped
+    if (debug && !paths.remapped(flags)) {
+        key += "cwd " + cwd + "\n";
+        key += "root " + paths.source() + "\n";
+    }
+
+    std::string expanded = output + ".i";
+    if (lists_macros(command[0])) preprocess.push_back("-dU");
+    preprocess.push_back("-E");
+    preprocess.push_back("-o");
+    preprocess.push_back(expanded);
+    if (run_command(preprocess, cwd) != 0) {
+        util::fs::remove_file(in_cwd(expanded));
+        return "";
+    }
+    std::string text = util::fs::read_file(in_cwd(expanded));
+    util::fs::remove_file(in_cwd(expanded));
+    std::set<std::string> used = take_macro_lines(text);
+    if (macros) *macros = used;
+    key += normalize_markers(text, paths);
+
+    return util::hash::sha256(key);
+}
+
+// splits a depfile into its target and prerequisites. escaped spaces stay
+// part of their path
+std::vector<std::string> depfile_tokens(const std::string& content) {
+    std::vector<std::string> tokens;
+    std::string current;
+
+    for (size_t i = 0; i < content.size(); i++) {
+        char c = content[i];
+        if (c == '\\' && i + 1 < content.size() && content[i + 1] == '\n') {
+            i++;
+            c = ' ';
+        } else if (c == '\\' && i + 1 < content.size()) {
+            current += c;
+            current += content[++i];
+            continue;
+        }
+        if (c == ' ' || c == '\n' || c == '\t' || c == '\r') {
+            if (!current.empty()) tokens.push_back(current);
+            current.clear();
+        } else {
+            current += c;
+        }
+    }
+    if (!current.empty()) tokens.push_back(current);
+    return tokens;
+}
+
+// rewrites a depfile for the cache (to_cache) or back for this checkout,
+// pointing it at output
+void convert_depfile(const std::string& from, const std::string& to,
+                     const std::string& output, const PathMap& paths, bool to_cache) {
+    std::vector<std::string> tokens = depfile_tokens(util::fs::read_file(from));
+    std::string result = to_cache ? "@OUTPUT@:" : output + ":";
+
+    // prerequisites follow the target's colon
+    size_t first = 0;
+    for (size_t i = 0; i < tokens.size(); i++) {
+        if (tokens[i].back() == ':') {
+            first = i + 1;
+            break;
+        }
+    }
+
+    for (size_t i = first; i < tokens.size(); i++) {
+        result += " \\\n  " + (to_cache ? paths.normalize(tokens[i]) : paths.expand(tokens[i]));
+    }
+    util::fs::write_file(to, result + "\n");
+}
+
+// stands for a missing file, real times may be negative on the file clock
+constexpr int64_t NO_MTIME = INT64_MIN;
+
+// the file's modification time in the filesystem's own resolution
+int64_t mtime_of(const std::string& path) {
+    std::error_code ec;
+    auto time = fs::last_write_time(path, ec);
+    return ec ? NO_MTIME : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+// token hashes of a file the compiles depend on. hashes are shared by every
+// compile of the build dir through .iris_tokens and reused while the file
+// keeps the mtime and size it was hashed with. empty when it is gone
+util::tokens::Hashes token_hashes(const std::string& path) {
+    int64_t mtime = mtime_of(path);
+    if (mtime == NO_MTIME) return {};
+    uint64_t size = util::fs::file_size(path);
+
+    std::string entry = std::string(TOKEN_HASHES) + "/" + util::hash::xxhash(path);
+    std::stringstream in(util::fs::read_file(entry));
+    int64_t stored_mtime = NO_MTIME;
+    uint64_t stored_size = 0;
+    util::tokens::Hashes hashes;
+    int line_macro = 0;
+    std::string stored_path;
+    in >> stored_mtime >> stored_size >> hashes.plain >> hashes.lines >> line_macro;
+    std::getline(in >> std::ws, stored_path);
+    if (stored_mtime == mtime && stored_size == size && stored_path == path) {
+        hashes.line_macro = line_macro != 0;
+        return hashes;
+    }
+
+    hashes = util::tokens::stream_hashes(util::fs::read_file(path));
+
+    // other compiles read these concurrently, replace entries whole
+#ifdef _WIN32
+    std::string temp = entry + "." + std::to_string(_getpid());
+#else
+    std::string temp = entry + "." + std::to_string(getpid());
+#endif
+    util::fs::create_directories(TOKEN_HASHES);
+    util::fs::write_file(temp, std::to_string(mtime) + " " + std::to_string(size) + " " +
+                               hashes.plain + " " + hashes.lines + " " +
+                               (hashes.line_macro ? "1 " : "0 ") + path + "\n");
+    if (std::rename(temp.c_str(), entry.c_str()) != 0) {
+        util::fs::remove_file(temp);
+    }
+    return hashes;
+}
+
+// files an object was built from: the depfile's prerequisites, or just the
+// source without one
+std::vector<std::string> dependencies(const std::vector<std::string>& command,
+                                      const std::string& depfile) {
+    std::vector<std::string> result;
+    if (depfile.empty() || !util::fs::exists(depfile)) {
+        std::string source = flag_value(command, "-c");
+        if (!source.empty()) result.push_back(source);
+        return result;
+    }
+
+    std::vector<std::string> tokens = depfile_tokens(util::fs::read_file(depfile));
+    bool prerequisites = false;
+    for (const auto& token : tokens) {
+        if (!prerequisites) {
+            prerequisites = token.back() == ':';
+            continue;
+        }
+        std::string path;
+        for (size_t i = 0; i < token.size(); i++) {
+            if (token[i] == '\\' && i + 1 < token.size()) {
+                path += token[++i];
+            } else if (token[i] == '$' && i + 1 < token.size() && token[i + 1] == '$') {
+                path += token[++i];
+            } else {
+                path += token[i];
+            }
+        }
+        result.push_back(path);
+    }
+    return result;
+}
+
+// -D and -U flags, each with its value joined to it
+bool is_define(const std::string& arg) {
+    return arg.size() >= 2 && (arg.compare(0, 2, "-D") == 0 || arg.compare(0, 2, "-U") == 0);
+}
+
+std::vector<std::string> define_args(const std::vector<std::string>& command) {
+    std::vector<std::string> defines;
+    for (size_t i = 0; i < command.size(); i++) {
+        if ((command[i] == "-D" || command[i] == "-U") && i + 1 < command.size()) {
+            defines.push_back(command[i] + command[i + 1]);
+            i++;
+        } else if (is_define(command[i])) {
+            defines.push_back(command[i]);
+        }
+    }
+    return defines;
+}
+
+// identifies the command an object record was written for, defines aside
+std::string command_hash(const std::vector<std::string>& command) {
+    std::string text = "iris-tokens-3\n";
+    for (size_t i = 0; i < command.size(); i++) {
+        if ((command[i] == "-D" || command[i] == "-U") && i + 1 < command.size()) {
+            i++;
+        } else if (!is_define(command[i])) {
+            text += command[i] + "\n";
+        }
+    }
+    return util::hash::sha256(text);
+}
+
+// the macros a define list leaves defined, applied in order the way the
+// compiler does
+std::map<std::string, std::string> macro_values(const std::vector<std::string>& defines) {
+    std::map<std::string, std::string> result;
+    for (const auto& define : defines) {
+        std::string body = define.substr(2);
+        size_t eq = body.find('=');
+        std::string name = body.substr(0, std::min(eq, body.find('(')));
+        if (define[1] == 'U') {
+            result.erase(name);
+        } else {
+            result[name] = eq == std::string::npos ? body + "=1" : body;
+        }
+    }
+    return result;
+}
+
+// macros whose value differs between two define lists
+std::set<std::string> changed_macros(const std::vector<std::string>& before,
+                                     const std::vector<std::string>& after) {
+    std::map<std::string, std::string> a = macro_values(before);
+    std::map<std::string, std::string> b = macro_values(after);
+    std::set<std::string> changed;
+    for (const auto& [name, value] : a) {
+        auto found = b.find(name);
+        if (found == b.end() || found->second != value) changed.insert(name);
+    }
+    for (const auto& [name, value] : b) {
+        if (!a.count(name)) changed.insert(name);
+    }
+    return changed;
+}
+
+// macros used by the preprocessing of a compile that did not compute a
+// cache key, empty when they cannot be told
+std::set<std::string> scan_macros(const std::string& output, const std::vector<std::string>& command) {
+    if (!lists_macros(command[0])) return {};
+
+    std::vector<std::string> preprocess;
+    for (size_t i = 0; i < command.size(); i++) {
+        const std::string& arg = command[i];
+        if ((arg == "-o" || arg == "-MF" || arg == "-MT" || arg == "-MQ") && i + 1 < command.size()) {
+            i++;
+        } else if (arg != "-c" && arg != "-MMD" && arg != "-MD") {
+            preprocess.push_back(arg);
+        }
+    }
+    std::string expanded = output + ".macros.i";
+    preprocess.insert(preprocess.end(), {"-dU", "-E", "-o", expanded});
+
+    std::set<std::string> macros;
+    if (run_command(preprocess) == 0) {
+        std::string text = util::fs::read_file(expanded);
+        macros = take_macro_lines(text);
+    }
+    util::fs::remove_file(expanded);
+    return macros;
+}
+
+// debug info records line numbers, so there they count as well
+bool has_debug_info(const std::vector<std::string>& command) {
+    for (const auto& arg : command) {
+        if (arg.compare(0, 2, "-g") == 0 && arg != "-g0") return true;
+    }
+    return false;
+}
+
+// <object>.tok lists what an object was built from: the command's hash
+// without defines, the defines, the macros its preprocessing used ("?" when
+// unknown), where line numbers count and "mtime hash path" for every
+// dependency. they always count in the source, which is where macros like
+// assert expand, and in every dependency with debug info or once any of them
+// names a line macro, since a header can hide __LINE__ in a macro
+void write_token_record(const std::string& output,
+                        const std::vector<std::string>& command,
+                        const std::string& depfile,
+                        const std::set<std::string>& macros) {
+    std::string record = command_hash(command) + "\ndefines";
+    for (const auto& define : define_args(command)) {
+        record += "\t" + define;
+    }
+    record += "\nmacros";
+    for (const auto& macro : macros) {
+        record += " " + macro;
+    }
+    record += macros.empty() ? " ?\n" : "\n";
+
+    std::vector<std::string> paths = dependencies(command, depfile);
+    std::vector<util::tokens::Hashes> hashes;
+    bool lines = has_debug_info(command);
+    for (const auto& path : paths) {
+        hashes.push_back(token_hashes(path));
+        if (hashes.back().plain.empty()) return;
+        lines = lines || hashes.back().line_macro;
+    }
+    record += lines ? "lines all\n" : "lines source\n";
+
+    std::string source = flag_value(command, "-c");
+    for (size_t i = 0; i < paths.size(); i++) {
+        const std::string& hash = lines || paths[i] == source ? hashes[i].lines : hashes[i].plain;
+        record += std::to_string(mtime_of(paths[i])) + " " + hash + " " + paths[i] + "\n";
+    }
+    util::fs::write_file(output + ".tok", record);
+}
+
+// whether output is still what command would build. dependencies that were
+// touched must keep their tokens, and defines may only change for macros the
+// source never used. a passing record takes the new mtimes and defines, and
+// a missing depfile is written again for the build tool
+bool up_to_date(const std::string& output,
+                const std::vector<std::string>& command,
+                const std::string& depfile) {
+    std::string record = output + ".tok";
+    if (!util::fs::exists(output) || !util::fs::exists(record)) return false;
+
+    std::stringstream in(util::fs::read_file(record));
+    std::string hash;
+    std::string defines_line;
+    std::string macros_line;
+    std::string lines_line;
+    if (!std::getline(in, hash) || hash != command_hash(command) ||
+        !std::getline(in, defines_line) || !std::getline(in, macros_line) ||
+        !std::getline(in, lines_line) || defines_line.compare(0, 7, "defines") != 0 ||
+        macros_line.compare(0, 6, "macros") != 0 || lines_line.compare(0, 5, "lines") != 0) {
+        return false;
+    }
+
+    std::vector<std::string> defines;
+    std::stringstream define_fields(defines_line.substr(7));
+    for (std::string define; std::getline(define_fields, define, '\t');) {
+        if (!define.empty()) defines.push_back(define);
+    }
+    std::vector<std::string> current_defines = define_args(command);
+    std::set<std::string> added;
+    bool changed = false;
+    if (defines != current_defines) {
+        std::set<std::string> used;
+        std::stringstream macro_fields(macros_line.substr(6));
+        for (std::string macro; macro_fields >> macro;) {
+            used.insert(macro);
+        }
+        if (used.count("?")) return false;
+        std::map<std::string, std::string> previous = macro_values(defines);
+        for (const auto& macro : changed_macros(defines, current_defines)) {
+            if (used.count(macro)) return false;
+            if (!previous.count(macro)) added.insert(macro);
+        }
+        changed = true;
+    }
+
+    bool lines = lines_line == "lines all";
+    std::string source = flag_value(command, "-c");
+    std::string updated = hash + "\ndefines";
+    for (const auto& define : current_defines) {
+        updated += "\t" + define;
+    }
+    updated += "\n" + macros_line + "\n" + lines_line + "\n";
+
+    std::vector<std::string> paths;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::stringstream fields(line);
+        int64_t mtime = NO_MTIME;
+        std::string stored;
+        std::string path;
+        fields >> mtime >> stored;
+        std::getline(fields >> std::ws, path);
+        if (path.empty()) return false;
+
+        int64_t current = mtime_of(path);
+        if (current != mtime) {
+            util::tokens::Hashes hashes = token_hashes(path);
+            if ((lines || path == source ? hashes.lines : hashes.plain) != stored) return false;
+            changed = true;
+        }
+        updated += std::to_string(current) + " " + stored + " " + path + "\n";
+        paths.push_back(path);
+    }
+    if (paths.empty()) return false;
+
+    // -dU only names what already was a macro. a new one may still replace
+    // an ordinary identifier of the source
+    for (size_t i = 0; !added.empty() && i < paths.size(); i++) {
+        std::set<std::string> names = util::tokens::identifiers(util::fs::read_file(paths[i]));
+        for (const auto& macro : added) {
+            if (names.count(macro)) return false;
+        }
+    }
+
+    if (changed) util::fs::write_file(record, updated);
+
+    if (!depfile.empty() && !util::fs::exists(depfile)) {
+        std::string target = flag_value(command, "-MT");
+        std::string content = (target.empty() ? output : target) + ":";
+        for (const auto& path : paths) {
+            std::string escaped;
+            for (char c : path) {
+                if (c == ' ' || c == '#') escaped += '\\';
+                if (c == '$') escaped += '$';
+                escaped += c;
+            }
+            content += " \\\n  " + escaped;
+        }
+        util::fs::write_file(depfile, content + "\n");
+    }
+    return true;
+}
+
+} // namespace
+
+std::string cache_key(const std::string& output,
+                      const std::vector<std::string>& command,
+                      const std::string& source_root,
+                      const std::string& build_dir) {
+    std::error_code ec;
+    std::string cwd = fs::weakly_canonical(fs::absolute(build_dir), ec).string();
+    if (ec) cwd = fs::absolute(build_dir).lexically_normal().string();
+    while (cwd.size() > 1 && cwd.back() == '/') cwd.pop_back();
+
+    return action_key(output, command, PathMap(source_root, cwd), cwd);
+}
+
+int compile_with_cutoff(const std::string& output,
+                        const std::vector<std::string>& command,
+                        const std::string& cache_dir,
+                        const std::string& source_root,
+                        const std::string& remote) {
+    if (command.empty()) {
+        throw std::runtime_error("No compiler command given");
+    }
+
+    std::string temp = output + ".tmp";
+    std::vector<std::string> args = command;
+    bool redirected = false;
+
+    for (size_t i = 0; i + 1 < args.size(); i++) {
+        if (args[i] == "-o" && args[i + 1] == output) {
+            args[i + 1] = temp;
+            redirected = true;
+            break;
+        }
+    }
+
+    std::string depfile = flag_value(command, "-MF");
+
+    // only comments, whitespace or defines the source never looks at
+    // changed since the object was built, it stays as it is
+    if (redirected && up_to_date(output, command, depfile)) {
+        util::fs::append_file(CUTOFF_LOG, output + "\n");
+        return 0;
+    }
+
+    std::string cwd = util::fs::current_path();
+    PathMap paths(source_root, cwd);
+    std::set<std::string> macros;
+    std::string key = redirected && !cache_dir.empty() ? action_key(output, command, paths, cwd, &macros) : "";
+
+    if (!key.empty()) {
+        Cache cache(cache_dir);
+        cache.set_remote(remote);
+        std::map<std::string, std::string> files = {{"object", temp}};
+        if (!depfile.empty()) files["depfile"] = depfile;
+
+        if (cache.restore(key, files)) {
+            if (!depfile.empty()) convert_depfile(depfile, depfile, output, paths, false);
+            if (util::fs::exists(output)) {
+                keep_or_replace(temp, output);
+            } else if (std::rename(temp.c_str(), output.c_str()) != 0) {
+                throw std::runtime_error("Cannot replace " + output);
+            }
+            write_token_record(output, command, depfile, macros);
+            return 0;
+        }
+    }
+
+    int result = 0;
+    if (!redirected || !util::fs::exists(output)) {
+        // nothing to compare against, run the command as is
+        result = run_command(command);
+    } else {
+        result = run_command(args);
+        if (result != 0) {
+            util::fs::remove_file(temp);
+            return result;
+        }
+        keep_or_replace(temp, output);
+    }
+
+    if (result == 0 && redirected) {
+        if (key.empty() && !define_args(command).empty()) macros = scan_macros(output, command);
+        write_token_record(output, command, depfile, macros);
+    }
+
+    if (result == 0 && !key.empty()) {
+        // the cached depfile uses placeholders, this one stays for the build
+        std::map<std::string, std::string> files = {{"object", output}};
+        std::string portable = depfile + ".cache";
+        if (!depfile.empty() && util::fs::exists(depfile)) {
+            convert_depfile(depfile, portable, output, paths, true);
+            files["depfile"] = portable;
+        }
+        Cache cache(cache_dir);
+        cache.set_remote(remote);
+        cache.store(key, output, files);
+        util::fs::remove_file(portable);
+    }
+
+    return result;
+}
+
+int compile_batch(const std::string& batch,
+                  const std::vector<std::pair<std::string, std::string>>& sources,
+                  const std::vector<std::string>& command) {
+    if (command.empty() || sources.empty()) {
+        throw std::runtime_error("Empty compile batch");
+    }
+
+    // objects land in the compiler's working directory named after their
+    // source, the generator keeps those names unique within a batch
+    std::string scratch = batch + ".tmp";
+    util::fs::remove_all(scratch);
+    util::fs::create_directories(scratch);
+
+    std::vector<std::string> args = absolute_paths(command);
+    args.push_back("-c");
+    for (const auto& [source, object] : sources) {
+        args.push_back(fs::absolute(source).lexically_normal().string());
+    }
+
+    int result = run_command(args, scratch);
+
+    std::vector<std::string> failed;
+    std::string deps;
+
+    for (const auto& [source, object] : sources) {
+        std::string stem = fs::path(source).stem().string();
+        std::string temp = scratch + "/" + stem + ".o";
+        if (!util::fs::exists(temp)) {
+            failed.push_back(source);
+            continue;
+        }
+
+        util::fs::create_directories(fs::path(object).parent_path().string());
+        keep_or_replace(temp, object);
+
+        // the batch has a single depfile, ninja only needs the union
+        std::string depfile = util::fs::read_file(scratch + "/" + stem + ".d");
+        size_t colon = depfile.find(": ");
+        if (colon != std::string::npos) {
+            std::string list = depfile.substr(colon + 1);
+            while (!list.empty() && (list.back() == '\n' || list.back() == ' ')) list.pop_back();
+            deps += " \\\n" + list;
+        }
+    }
+
+    if (!deps.empty()) {
+        util::fs::write_file(batch + ".d", sources.front().second + ":" + deps + "\n");
+    }
+
+    util::fs::remove_all(scratch);
+
+    for (const auto& source : failed) {
+        std::cerr << "iris: failed to compile " << source << "\n";
+    }
+    if (!failed.empty()) {
+        return result != 0 ? result : 1;
+    }
+    return result;
+}
+
+int count_cutoffs(const std::string& build_dir) {
+    std::ifstream log(build_dir + "/" + CUTOFF_LOG);
+    int count = 0;
+    std::string line;
+    while (std::getline(log, line)) {
+        if (!line.empty()) count++;
+    }
+    return count;
+}
+
+} // namespace iris::core
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace iris::core {
+
+// file in the build directory listing outputs that were left untouched
+constexpr const char* CUTOFF_LOG = ".iris_cutoff";
+
+// directory in the build dir holding token hashes of the files compiles
+// depend on
+constexpr const char* TOKEN_HASHES = ".iris_tokens";
+
+// runs a compiler command with its "-o <output>" redirected to a temporary
+// file. when the result is byte identical to the existing output the old file
+// is kept as is, so its timestamp does not move and ninja (restat) or make
+// skip everything downstream. with a cache_dir, results are looked up in and
+// stored to the build cache keyed on the preprocessed source, the compiler and
+// its flags. paths under source_root and the build dir (the working
+// directory) are normalized first, so other checkouts share the entries.
+// with a remote url, local misses are looked up there and new entries are
+// queued for upload. an object whose dependencies only changed in comments
+// or whitespace (same token stream, see <object>.tok) is not compiled again.
+// returns the compiler's exit code
+int compile_with_cutoff(const std::string& output,
+                        const std::vector<std::string>& command,
+                        const std::string& cache_dir = "",
+                        const std::string& source_root = "",
+                        const std::string& remote = "");
+
+// the cache key compile_with_cutoff computes for command when run in
+// build_dir, empty when it cannot be cached. runs the preprocessor
+std::string cache_key(const std::string& output,
+                      const std::vector<std::string>& command,
+                      const std::string& source_root,
+                      const std::string& build_dir);
+
+// compiles several sources with one compiler process to save its startup.
+// sources maps each source to its object, command is the compiler and flags
+// without -c, inputs or -o. it runs in a scratch directory next to the batch
+// (relative include paths are made absolute), objects are moved into place
+// with the same cutoff as above and member depfiles are merged into
+// <batch>.d. sources that fail are named on stderr and fail the batch.
+// batches never use the build cache
+int compile_batch(const std::string& batch,
+                  const std::vector<std::pair<std::string, std::string>>& sources,
+                  const std::vector<std::string>& command);
+
+// number of outputs recorded in the cutoff log of a build directory
+int count_cutoffs(const std::string& build_dir);
+
+} // namespace iris::core
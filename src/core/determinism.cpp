@@ -0,0 +1,149 @@
+#include "determinism.hpp"
+#include "runner.hpp"
+#include "../util/elf.hpp"
+#include "../util/fs.hpp"
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+namespace iris::core {
+
+namespace {
+
+void add_unique(std::vector<std::string>& names, const std::string& name) {
+    if (std::find(names.begin(), names.end(), name) == names.end()) {
+        names.push_back(name);
+    }
+}
+
+// sections of b that differ from a. objects with the same layout are paired
+// by index (comdat groups repeat names like .group), otherwise by name
+std::vector<std::string> diff_sections(const util::elf::File& a, const util::elf::File& b) {
+    std::vector<std::string> names;
+    const auto& left = a.sections();
+    const auto& right = b.sections();
+
+    auto contents = [](const util::elf::File& file, const util::elf::Section& section) {
+        return section.type == util::elf::SHT_NOBITS ? std::to_string(section.size)
+                                                     : file.section_data(section);
+    };
+
+    if (left.size() == right.size()) {
+        for (size_t i = 0; i < left.size(); i++) {
+            if (left[i].name != right[i].name) {
+                add_unique(names, left[i].name);
+                add_unique(names, right[i].name);
+            } else if (left[i].type != right[i].type ||
+                       contents(a, left[i]) != contents(b, right[i])) {
+                add_unique(names, right[i].name);
+            }
+        }
+        return names;
+    }
+
+    std::map<std::string, std::vector<std::string>> by_name;
+    for (const auto& section : left) {
+        by_name[section.name].push_back(contents(a, section));
+    }
+    for (const auto& section : right) {
+        auto found = by_name.find(section.name);
+        if (found == by_name.end() || found->second.empty()) {
+            add_unique(names, section.name);
+            continue;
+        }
+        auto& candidates = found->second;
+        auto match = std::find(candidates.begin(), candidates.end(), contents(b, section));
+        if (match == candidates.end()) {
+            add_unique(names, section.name);
+            candidates.erase(candidates.begin());
+        } else {
+            candidates.erase(match);
+        }
+    }
+    for (const auto& [name, rest] : by_name) {
+        if (!rest.empty()) add_unique(names, name);
+    }
+    return names;
+}
+
+// sections whose contents mention one of roots
+std::vector<std::string> find_paths(const util::elf::File& file, const std::vector<std::string>& roots) {
+    std::vector<std::string> names;
+    for (const auto& section : file.sections()) {
+        if (section.type == util::elf::SHT_NOBITS) continue;
+        std::string data = file.section_data(section);
+        for (const auto& root : roots) {
+            if (!root.empty() && root != "/" && data.find(root) != std::string::npos) {
+                add_unique(names, section.name);
+                break;
+            }
+        }
+    }
+    return names;
+}
+
+} // namespace
+
+DeterminismResult check_determinism(const std::string& object,
+                                    const std::vector<std::string>& arguments,
+                                    const std::string& build_dir,
+                                    const std::string& scratch,
+                                    const std::vector<std::string>& roots) {
+    DeterminismResult result;
+    result.object = object;
+
+    // same command and working directory, only the outputs move. -Wdate-time
+    // names sources that expand __DATE__ or __TIME__
+    std::string output = scratch + "/" + util::fs::basename(object);
+    std::vector<std::string> command;
+    for (size_t i = 0; i < arguments.size(); i++) {
+        if (arguments[i] == "-o" && i + 1 < arguments.size()) {
+            command.insert(command.end(), {"-o", output});
+            i++;
+        } else if (arguments[i] == "-MF" && i + 1 < arguments.size()) {
+            command.insert(command.end(), {"-MF", output + ".d"});
+            i++;
+        } else {
+            command.push_back(arguments[i]);
+        }
+    }
+    command.insert(command.end(), {"-Wdate-time", "-Wno-error=date-time"});
+
+    util::fs::create_directories(build_dir + "/" + scratch);
+    Runner runner;
+    runner.set_working_dir(build_dir);
+    RunResult run = runner.run(command);
+
+    result.date_time = run.stdout_output.find("-Wdate-time") != std::string::npos;
+    std::string original = build_dir + "/" + object;
+    std::string rebuilt = build_dir + "/" + output;
+    if (run.exit_code != 0 || !util::fs::exists(rebuilt)) {
+        util::fs::remove_all(build_dir + "/" + scratch);
+        return result;
+    }
+    result.rebuilt = true;
+
+    std::string before = util::fs::read_file(original);
+    std::string after = util::fs::read_file(rebuilt);
+    result.identical = before == after;
+
+    if (util::fs::exists(original) && util::elf::is_elf(original) && util::elf::is_elf(rebuilt)) {
+        try {
+            util::elf::File a(original);
+            util::elf::File b(rebuilt);
+            if (!result.identical) {
+                result.sections = diff_sections(a, b);
+                if (result.sections.empty()) result.sections.push_back("(elf headers)");
+            }
+            result.leaks = find_paths(b, roots);
+        } catch (const std::exception&) {
+            // not an object iris can read, the hash comparison still holds
+        }
+    }
+
+    util::fs::remove_all(build_dir + "/" + scratch);
+    return result;
+}
+
+} // namespace iris::core
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace iris::core {
+
+// scratch directory inside the build dir used for determinism rebuilds
+constexpr const char* DETERMINISM_DIR = ".iris_determinism";
+
+// one compile rebuilt and compared with the object the build left behind
+struct DeterminismResult {
+    std::string object;                 // relative to the build dir
+    bool rebuilt = false;               // false when the second compile failed
+    bool identical = false;
+    std::vector<std::string> sections;  // elf sections whose contents differ
+    std::vector<std::string> leaks;     // elf sections holding an absolute checkout path
+    bool date_time = false;             // -Wdate-time fired on the source
+};
+
+// runs arguments (a compile exactly as the build ran it in build_dir) again
+// with its outputs moved to scratch, then compares the result with object.
+// differing objects are diffed section by section when they are elf. roots
+// are absolute paths that must not end up in objects shared through the cache
+DeterminismResult check_determinism(const std::string& object,
+                                    const std::vector<std::string>& arguments,
+                                    const std::string& build_dir,
+                                    const std::string& scratch,
+                                    const std::vector<std::string>& roots);
+
+} // namespace iris::core
@@ -1,8 +1,11 @@
 #include "engine.hpp"
 #include "cache.hpp"
 #include "graph.hpp"
+#include "modules.hpp"
+#include "compile.hpp"
 #include "../util/fs.hpp"
 #include "../util/hash.hpp"
+#include "../util/json.hpp"
 #include "../ui/terminal.hpp"
 
 #include <fstream>
@@ -11,14 +14,58 @@
 #include <algorithm>
 #include <cstdlib>
 #include <thread>
+#include <atomic>
 #include <chrono>
 #include <stdexcept>
 #include <regex>
+#include <random>
+#include <set>
+#include <tuple>
 
 namespace fs = std::filesystem;
 
 namespace iris::core {
 
+namespace {
+
+// cacheable compiles of the build, one "object source args..." line each
+// with tabs between the fields
+constexpr const char* COMPILE_COMMANDS = ".iris_commands";
+
+// sharded compilation database, one compile_commands.json per source directory
+constexpr const char* COMPDB_SHARDS = "compdb";
+
+// flags as the shell splits them, the generator never quotes
+std::vector<std::string> split_flags(const std::string& flags) {
+    std::vector<std::string> words;
+    std::stringstream in(flags);
+    std::string word;
+    while (in >> word) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+std::vector<CompileCommand> read_compile_commands(const std::string& build_dir) {
+    std::vector<CompileCommand> commands;
+    std::ifstream list(build_dir + "/" + COMPILE_COMMANDS);
+    std::string line;
+    while (std::getline(list, line)) {
+        std::vector<std::string> fields;
+        std::stringstream in(line);
+        std::string field;
+        while (std::getline(in, field, '\t')) {
+            fields.push_back(field);
+        }
+        if (fields.size() >= 3) {
+            commands.push_back({fields[0], fields[1], {fields.begin() + 2, fields.end()}});
+        }
+    }
+    return commands;
+}
+
+} // namespace
+
 Engine::Engine() = default;
 
 Engine::Engine(const BuildConfig& config) : m_config(config) {}
@@ -35,41 +82,14 @@ void Engine::load_from_build_dir(const std::string& build_dir) {
         throw std::runtime_error("No configuration found in " + build_dir);
     }
     
-    // parse the config file
-    std::ifstream file(config_file);
-    if (!file.is_open()) {
-        throw std::runtime_error("Cannot open " + config_file);
-    }
-    
-    std::string line;
-    while (std::getline(file, line)) {
-        // simple json parsing extract key fields
-        size_t pos;
-        
-        if ((pos = line.find("\"project\":")) != std::string::npos) {
-            size_t start = line.find("\"", pos + 10) + 1;
-            size_t end = line.find("\"", start);
-            if (start != std::string::npos && end != std::string::npos) {
-                m_config.project_name = line.substr(start, end - start);
-            }
-        }
-        
-        if ((pos = line.find("\"version\":")) != std::string::npos) {
-            size_t start = line.find("\"", pos + 10) + 1;
-            size_t end = line.find("\"", start);
-            if (start != std::string::npos && end != std::string::npos) {
-                m_config.version = line.substr(start, end - start);
-            }
-        }
-        
-        if ((pos = line.find("\"build_type\":")) != std::string::npos) {
-            size_t start = line.find("\"", pos + 13) + 1;
-            size_t end = line.find("\"", start);
-            if (start != std::string::npos && end != std::string::npos) {
-                m_config.build_type = line.substr(start, end - start);
-            }
-        }
-    }
+    util::json::Value doc = util::json::parse(util::fs::read_file(config_file));
+    m_config.project_name = doc["project"].as_string();
+    m_config.version = doc["version"].as_string();
+    m_config.build_type = doc["build_type"].as_string();
+    m_config.cache_dir = doc["cache_dir"].as_string();
+    m_config.source_root = doc["source_root"].as_string();
+    m_config.remote_cache = doc["remote_cache"].as_string();
+    m_config.source_date_epoch = doc["source_date_epoch"].as_string();
 }
 
 void Engine::generate_build_files(const std::string& build_dir,
@@ -77,6 +97,23 @@ void Engine::generate_build_files(const std::string& build_dir,
     m_build_dir = build_dir;
     fs::create_directories(build_dir);
 
+    // developer mode, every library becomes a shared object so a change only
+    // relinks its own library. release builds keep their static archives
+    if (m_config.dev_shared) {
+        if (m_config.build_type == "release" || m_config.build_type == "minsize") {
+            ui::Terminal::warning("--dev-shared is ignored for " + m_config.build_type + " builds");
+        } else {
+            for (auto& target : m_config.targets) {
+                if (target.type == TargetType::Library || target.type == TargetType::StaticLibrary) {
+                    target.type = TargetType::SharedLibrary;
+                    target.dev_shared = true;
+                }
+            }
+        }
+    }
+
+    m_compile_commands.clear();
+    m_database.clear();
     if (backend == "ninja") {
         generate_ninja(build_dir);
     } else if (backend == "make") {
@@ -84,6 +121,10 @@ void Engine::generate_build_files(const std::string& build_dir,
     } else {
         throw std::runtime_error("Unknown backend: " + backend);
     }
+    write_compile_commands(build_dir);
+    write_database(build_dir);
+    write_tests(build_dir);
+    write_benchmarks(build_dir);
 
     // save configuration as json
     std::ofstream config_out(build_dir + "/iris-config.json");
@@ -94,6 +135,10 @@ void Engine::generate_build_files(const std::string& build_dir,
     config_out << "  \"standard\": \"" << m_config.standard << "\",\n";
     config_out << "  \"build_type\": \"" << m_config.build_type << "\",\n";
     config_out << "  \"backend\": \"" << backend << "\",\n";
+    config_out << "  \"cache_dir\": \"" << util::json::escape(m_config.cache_dir) << "\",\n";
+    config_out << "  \"source_root\": \"" << util::json::escape(m_config.source_root) << "\",\n";
+    config_out << "  \"remote_cache\": \"" << util::json::escape(m_config.remote_cache) << "\",\n";
+    config_out << "  \"source_date_epoch\": \"" << m_config.source_date_epoch << "\",\n";
     config_out << "  \"targets\": [\n";
     
     for (size_t i = 0; i < m_config.targets.size(); i++) {
@@ -102,10 +147,13 @@ void Engine::generate_build_files(const std::string& build_dir,
         config_out << "      \"name\": \"" << target.name << "\",\n";
         config_out << "      \"type\": \"";
         switch (target.type) {
-            case TargetType::Executable: config_out << "executable"; break;
+            case TargetType::Executable:
+                config_out << (target.test ? "test" : target.benchmark ? "benchmark" : "executable");
+                break;
             case TargetType::Library: config_out << "library"; break;
             case TargetType::StaticLibrary: config_out << "static_library"; break;
             case TargetType::SharedLibrary: config_out << "shared_library"; break;
+            case TargetType::Object: config_out << "object_library"; break;
             default: config_out << "unknown"; break;
         }
         config_out << "\"\n";
@@ -133,7 +181,11 @@ void Engine::generate_ninja(const std::string& build_dir) {
     ninja << "# Project: " << m_config.project_name << "\n";
     ninja << "# Do not edit manually\n\n";
 
-    ninja << "ninja_required_version = 1.5\n\n";
+    // module dependencies are discovered at build time through dyndep
+    bool any_modules = std::any_of(m_config.targets.begin(), m_config.targets.end(),
+        [this](const Target& t) { return uses_modules(t); });
+
+    ninja << "ninja_required_version = " << (any_modules ? "1.10" : "1.5") << "\n\n";
 
     // compiler variables
     std::string cc = get_compiler();
@@ -141,20 +193,77 @@ void Engine::generate_ninja(const std::string& build_dir) {
     
     ninja << "cc = " << cc << "\n";
     ninja << "cxx = " << cxx << "\n";
-    ninja << "ar = ar\n\n";
+    ninja << "ar = ar\n";
+    ninja << "iris = " << util::fs::executable_path() << "\n";
+    ninja << "cache_dir = " << m_config.cache_dir << "\n";
+    ninja << "source_root = " << m_config.source_root << "\n";
+    ninja << "remote_cache = " << m_config.remote_cache << "\n\n";
 
     // compile rules
     if (m_config.language == "c" || m_config.language == "mixed") {
+        // compiles go through iris so that unchanged objects keep their
+        // timestamp, restat then prunes the archive and link steps after them
         ninja << "rule cc\n";
-        ninja << "  command = $cc -MMD -MF $out.d $cflags -c $in -o $out\n";
+        ninja << "  command = $iris compile --cache=$cache_dir --root=$source_root --remote=$remote_cache $out -- $cc -MMD -MF $out.d -MT $out $cflags -c $in -o $out\n";
         ninja << "  depfile = $out.d\n";
         ninja << "  deps = gcc\n";
+        ninja << "  restat = 1\n";
         ninja << "  description = CC $out\n\n";
     }
 
     if (m_config.language == "cpp" || m_config.language == "mixed" || m_config.language.empty()) {
         ninja << "rule cxx\n";
-        ninja << "  command = $cxx -MMD -MF $out.d $cxxflags -c $in -o $out\n";
+        ninja << "  command = $iris compile --cache=$cache_dir --root=$source_root --remote=$remote_cache $out -- $cxx -MMD -MF $out.d -MT $out $cxxflags -c $in -o $out\n";
+        ninja << "  depfile = $out.d\n";
+        ninja << "  deps = gcc\n";
+        ninja << "  restat = 1\n";
+        ninja << "  description = CXX $out\n\n";
+    }
+
+    // independent of the project language, a target with c++ sources may
+    // still ask for a pch
+    bool any_pch = std::any_of(m_config.targets.begin(), m_config.targets.end(),
+        [](const Target& t) { return !t.pch.empty(); });
+    if (any_pch) {
+        ninja << "rule pch_cxx\n";
+        ninja << "  command = $cxx -MMD -MF $out.d $cxxflags -x c++-header $in -o $out\n";
+        ninja << "  depfile = $out.d\n";
+        ninja << "  deps = gcc\n";
+        ninja << "  description = PCH $out\n\n";
+    }
+
+    if (any_modules) {
+        // scan for p1689 module dependencies, then collate them into dyndep
+        ninja << "rule scan_cxx\n";
+        if (is_clang()) {
+            std::string scan_deps = "clang-scan-deps";
+            size_t pos = cxx.find("clang++");
+            if (pos != std::string::npos) {
+                scan_deps = cxx.substr(0, pos) + "clang-scan-deps" + cxx.substr(pos + 7);
+            }
+            ninja << "  command = " << scan_deps << " -format=p1689 -- $cxx $cxxflags -x c++ $in"
+                  << " -c -o $obj -MT $out -MD -MF $out.d > $out\n";
+        } else {
+            ninja << "  command = $cxx $cxxflags -E -x c++ $in -MT $out -MD -MF $out.d -fmodules-ts"
+                  << " -fdeps-file=$out -fdeps-target=$obj -fdeps-format=p1689r5 -o $out.i\n";
+        }
+        ninja << "  depfile = $out.d\n";
+        ninja << "  deps = gcc\n";
+        ninja << "  description = SCAN $in\n\n";
+
+        ninja << "rule collate_modules\n";
+        ninja << "  command = $iris collate-modules --units modules.units --format "
+              << (is_clang() ? "clang" : "gcc") << " --output $out\n";
+        ninja << "  description = COLLATE $out\n";
+        ninja << "  restat = 1\n\n";
+
+        ninja << "rule cxx_module\n";
+        if (is_clang()) {
+            ninja << "  command = $cxx -MMD -MF $out.d $cxxflags @$out.modmap -c $in -o $out\n";
+        } else {
+            ninja << "  command = $cxx -MMD -MF $out.d $cxxflags -fmodules-ts -fmodule-mapper=$out.modmap"
+                  << " -x c++ -c $in -o $out\n";
+        }
         ninja << "  depfile = $out.d\n";
         ninja << "  deps = gcc\n";
         ninja << "  description = CXX $out\n\n";
@@ -165,9 +274,29 @@ void Engine::generate_ninja(const std::string& build_dir) {
     ninja << "  command = $cxx $ldflags $in -o $out $libs\n";
     ninja << "  description = LINK $out\n\n";
 
+    // shared links also record the exported interface, dependents only
+    // relink when that changes
     ninja << "rule link_shared\n";
-    ninja << "  command = $cxx -shared $ldflags $in -o $out $libs\n";
-    ninja << "  description = LINK_SHARED $out\n\n";
+    ninja << "  command = $cxx -shared $ldflags $in -o $out $libs && $iris interface $out $out.iface\n";
+    ninja << "  description = LINK_SHARED $out\n";
+    ninja << "  restat = 1\n\n";
+
+    // several small sources per compiler process, see get_compile_batches
+    for (const char* lang : {"cc", "cxx"}) {
+        std::string flags_var = std::string(lang) == "cc" ? "$cflags" : "$cxxflags";
+        ninja << "rule " << lang << "_batch\n";
+        ninja << "  command = $iris compile-batch $batch $sources -- $" << lang << " -MMD " << flags_var << "\n";
+        ninja << "  depfile = $batch.d\n";
+        ninja << "  deps = gcc\n";
+        ninja << "  restat = 1\n";
+        ninja << "  description = " << (std::string(lang) == "cc" ? "CC" : "CXX") << " $batch\n\n";
+    }
+
+    // the compiler driver runs the linker it was configured with, so cross
+    // toolchains and -flto objects merge the way the final link reads them
+    ninja << "rule partial_link\n";
+    ninja << "  command = $cxx -r -nostdlib $ldflags $in -o $out\n";
+    ninja << "  description = PARTIAL $out\n\n";
 
     ninja << "rule ar_static\n";
     ninja << "  command = $ar rcs $out $in\n";
@@ -175,6 +304,8 @@ void Engine::generate_ninja(const std::string& build_dir) {
 
     // build statements for each target
     std::vector<std::string> all_outputs;
+    std::set<std::string> emitted_pch;
+    std::vector<ModuleUnit> module_units;
 
     for (const auto& target : m_config.targets) {
         std::vector<std::string> objects;
@@ -182,62 +313,157 @@ void Engine::generate_ninja(const std::string& build_dir) {
         std::string link_flags = get_link_flags(target);
         std::string libs = get_libs(target);
 
-        // resolve source files
-        auto sources = resolve_sources(target);
+        // resolve source files into compile units
+        auto units = get_compile_units(target, build_dir);
         
-        if (sources.empty()) {
+        if (units.empty()) {
             Terminal::warning("Target '" + target.name + "' has no sources");
             continue;
         }
 
         ninja << "# Target: " << target.name << "\n";
 
-        // compile each source file
-        for (const auto& src : sources) {
-            fs::path src_path(src);
-            std::string obj_name = src_path.stem().string();
-            
-            // handle duplicate filenames from different directories
-            std::string rel_path = src;
-            std::replace(rel_path.begin(), rel_path.end(), '/', '_');
-            std::replace(rel_path.begin(), rel_path.end(), '\\', '_');
-            if (rel_path.length() > 50) {
-                // Use hash for very long paths
-                obj_name = obj_name + "_" + util::hash::xxhash(src).substr(0, 8);
-            } else {
-                obj_name = fs::path(rel_path).stem().string();
+        bool modules = uses_modules(target);
+        if (modules && !target.pch.empty()) {
+            Terminal::warning("Target '" + target.name + "' uses C++ modules, ignoring pch");
+        }
+
+        // precompiled header, emitted once for all targets sharing its flags
+        auto pch = modules ? std::nullopt : get_pch(target, build_dir, compile_flags);
+        if (pch && emitted_pch.insert(pch->output).second) {
+            ninja << "build " << pch->output << ": pch_cxx " << pch->header << "\n";
+            ninja << "  cxxflags = " << compile_flags << "\n";
+        }
+
+        // small sources go through batched compiler invocations
+        auto batches = modules ? std::vector<CompileBatch>{}
+                               : get_compile_batches(target, units, build_dir);
+        std::set<std::string> batched;
+        for (const auto& batch : batches) {
+            bool use_pch = pch && !batch.is_c;
+
+            ninja << "build";
+            for (const auto& unit : batch.units) {
+                ninja << " " << unit.object;
+                batched.insert(unit.object);
             }
-            
-            std::string obj = "obj/" + target.name + "/" + obj_name + ".o";
-            objects.push_back(obj);
+            ninja << ": " << (batch.is_c ? "cc_batch" : "cxx_batch");
+            for (const auto& unit : batch.units) {
+                ninja << " " << unit.source;
+            }
+            if (use_pch) {
+                ninja << " | " << pch->output;
+            }
+            ninja << "\n";
+            ninja << "  " << (batch.is_c ? "cflags" : "cxxflags") << " = " << compile_flags
+                  << (use_pch ? pch->flags : "") << "\n";
+            ninja << "  batch = " << batch.name << "\n";
+            for (const auto& unit : batch.units) {
+                add_to_database(target, unit, compile_flags + (use_pch ? pch->flags : ""));
+            }
+            ninja << "  sources =";
+            for (const auto& unit : batch.units) {
+                ninja << " " << unit.source << "=" << unit.object;
+            }
+            ninja << "\n";
+        }
+
+        // compile each unit
+        for (const auto& unit : units) {
+            objects.push_back(unit.object);
+            if (batched.count(unit.object)) {
+                continue;
+            }
+
+            // module aware units are scanned first and learn their bmi
+            // inputs and outputs from the collated dyndep file
+            if (modules && !unit.is_c) {
+                std::string ddi = unit.object + ".ddi";
+                module_units.push_back({unit.object, ddi, get_bmi_key(compile_flags)});
 
-            std::string ext = src_path.extension().string();
-            bool is_c = (ext == ".c");
-            std::string rule = is_c ? "cc" : "cxx";
-            std::string flags_var = is_c ? "cflags" : "cxxflags";
+                add_to_database(target, unit, compile_flags);
 
-            // determine source path relative to build dir
-            std::string src_rel = "../" + src;
+                ninja << "build " << ddi << ": scan_cxx " << unit.source << "\n";
+                ninja << "  cxxflags = " << compile_flags << "\n";
+                ninja << "  obj = " << unit.object << "\n";
+                ninja << "build " << unit.object << ": cxx_module " << unit.source << " || modules.dd\n";
+                ninja << "  cxxflags = " << compile_flags << "\n";
+                ninja << "  dyndep = modules.dd\n";
+                continue;
+            }
+
+            std::string rule = unit.is_c ? "cc" : "cxx";
+            std::string flags_var = unit.is_c ? "cflags" : "cxxflags";
+            bool use_pch = pch && !unit.is_c;
             
-            ninja << "build " << obj << ": " << rule << " " << src_rel << "\n";
-            ninja << "  " << flags_var << " = " << compile_flags << "\n";
+            add_to_database(target, unit, compile_flags + (use_pch ? pch->flags : ""));
+
+            ninja << "build " << unit.object << ": " << rule << " " << unit.source;
+            if (use_pch) {
+                ninja << " | " << pch->output;
+            }
+            ninja << "\n";
+            ninja << "  " << flags_var << " = " << compile_flags;
+            if (use_pch) {
+                ninja << pch->flags;
+            }
+            ninja << "\n";
+
+            // the same command the rule runs, for prefetching its cache entry
+            CompileCommand command{unit.object, unit.source,
+                                   split_flags(unit.is_c ? get_compiler() : get_cxx_compiler())};
+            auto& args = command.arguments;
+            args.insert(args.end(), {"-MMD", "-MF", unit.object + ".d", "-MT", unit.object});
+            for (const auto& flag : split_flags(compile_flags + (use_pch ? pch->flags : ""))) {
+                args.push_back(flag);
+            }
+            args.insert(args.end(), {"-c", unit.source, "-o", unit.object});
+            m_compile_commands.push_back(command);
         }
 
         ninja << "\n";
 
+        // merge objects into cached partial links, the final link then only
+        // reads one object per partition
+        if (target.incremental_link &&
+            (target.type == TargetType::Executable || target.type == TargetType::SharedLibrary)) {
+            objects.clear();
+            for (const auto& partition : get_link_partitions(target, units)) {
+                objects.push_back(partition.output);
+                if (partition.objects.size() < 2) continue;
+
+                ninja << "build " << partition.output << ": partial_link";
+                for (const auto& obj : partition.objects) {
+                    ninja << " " << obj;
+                }
+                ninja << "\n";
+                ninja << "  ldflags = " << get_partial_link_flags(target) << "\n";
+            }
+        }
+
         // link or archive
-        std::string output;
+        std::string output = get_output_name(target);
+
+        // libraries the link consumes are implicit inputs so ninja orders the
+        // link after them without delaying the compiles above
+        auto link_inputs = get_link_inputs(target);
+        auto object_inputs = get_object_inputs(target, build_dir);
         
         switch (target.type) {
             case TargetType::Executable:
-                output = target.name;
-#ifdef _WIN32
-                output += ".exe";
-#endif
                 ninja << "build " << output << ": link_exe";
                 for (const auto& obj : objects) {
                     ninja << " " << obj;
                 }
+                for (const auto& obj : object_inputs) {
+                    ninja << " " << obj;
+                }
+                if (!link_inputs.empty()) {
+                    ninja << " |";
+                    for (const auto& in : link_inputs) {
+                        ninja << " " << in;
+                    }
+                }
                 ninja << "\n";
                 ninja << "  ldflags = " << link_flags << "\n";
                 if (!libs.empty()) {
@@ -247,27 +473,38 @@ void Engine::generate_ninja(const std::string& build_dir) {
                 
             case TargetType::Library:
             case TargetType::StaticLibrary:
-                output = "lib" + target.name + ".a";
+                // archives only bundle their own objects, so they never wait
+                // on other targets
                 ninja << "build " << output << ": ar_static";
                 for (const auto& obj : objects) {
                     ninja << " " << obj;
                 }
                 ninja << "\n";
                 break;
+
+            case TargetType::Object:
+                // no archive, dependents link the objects directly
+                ninja << "build " << output << ": phony";
+                for (const auto& obj : objects) {
+                    ninja << " " << obj;
+                }
+                ninja << "\n";
+                break;
                 
             case TargetType::SharedLibrary:
-                output = "lib" + target.name;
-#ifdef __APPLE__
-                output += ".dylib";
-#elif defined(_WIN32)
-                output += ".dll";
-#else
-                output += ".so";
-#endif
-                ninja << "build " << output << ": link_shared";
+                ninja << "build " << output << " | " << output << ".iface: link_shared";
                 for (const auto& obj : objects) {
                     ninja << " " << obj;
                 }
+                for (const auto& obj : object_inputs) {
+                    ninja << " " << obj;
+                }
+                if (!link_inputs.empty()) {
+                    ninja << " |";
+                    for (const auto& in : link_inputs) {
+                        ninja << " " << in;
+                    }
+                }
                 ninja << "\n";
                 ninja << "  ldflags = " << link_flags << "\n";
                 if (!libs.empty()) {
@@ -283,6 +520,17 @@ void Engine::generate_ninja(const std::string& build_dir) {
         all_outputs.push_back(output);
     }
 
+    if (!module_units.empty()) {
+        write_module_units(build_dir + "/modules.units", module_units);
+
+        ninja << "# C++ modules\n";
+        ninja << "build modules.dd: collate_modules";
+        for (const auto& unit : module_units) {
+            ninja << " " << unit.ddi;
+        }
+        ninja << " | modules.units\n\n";
+    }
+
     // default target
     ninja << "# Default target\n";
     ninja << "build all: phony";
@@ -311,11 +559,19 @@ void Engine::generate_makefile(const std::string& build_dir) {
         throw std::runtime_error("Cannot create Makefile");
     }
 
+    for (const auto& target : m_config.targets) {
+        if (uses_modules(target)) {
+            throw std::runtime_error("Target '" + target.name +
+                                     "' uses C++ modules, which need the ninja backend");
+        }
+    }
+
     make << "# Generated by Iris Build System\n";
     make << "# Project: " << m_config.project_name << "\n";
     make << "# Do not edit manually\n\n";
 
-    make << ".PHONY: all clean\n\n";
+    make << ".PHONY: all clean\n";
+    make << ".DEFAULT_GOAL := all\n\n";
 
     // compiler variables
     std::string cc = get_compiler();
@@ -323,65 +579,80 @@ void Engine::generate_makefile(const std::string& build_dir) {
     
     make << "CC := " << cc << "\n";
     make << "CXX := " << cxx << "\n";
-    make << "AR := ar\n\n";
+    make << "AR := ar\n";
+    make << "IRIS := " << util::fs::executable_path() << "\n";
+    make << "IRIS_CACHE := " << m_config.cache_dir << "\n";
+    make << "IRIS_ROOT := " << m_config.source_root << "\n";
+    make << "IRIS_REMOTE := " << m_config.remote_cache << "\n\n";
+
+    if (!m_config.source_date_epoch.empty()) {
+        make << "export SOURCE_DATE_EPOCH := " << m_config.source_date_epoch << "\n\n";
+    }
 
     std::vector<std::string> all_outputs;
+    std::set<std::string> emitted_pch;
 
     for (const auto& target : m_config.targets) {
         std::string compile_flags = get_compile_flags(target);
         std::string link_flags = get_link_flags(target);
         std::string libs = get_libs(target);
-        auto sources = resolve_sources(target);
+        auto units = get_compile_units(target, build_dir);
 
-        if (sources.empty()) {
+        if (units.empty()) {
             continue;
         }
 
         std::vector<std::string> objects;
-        
-        for (const auto& src : sources) {
-            fs::path src_path(src);
-            std::string obj_name = src_path.stem().string();
-            std::string obj = "obj/" + target.name + "/" + obj_name + ".o";
-            objects.push_back(obj);
+        std::vector<LinkPartition> partitions;
+
+        if (target.incremental_link &&
+            (target.type == TargetType::Executable || target.type == TargetType::SharedLibrary)) {
+            partitions = get_link_partitions(target, units);
+            for (const auto& partition : partitions) {
+                objects.push_back(partition.output);
+            }
+        } else {
+            for (const auto& unit : units) {
+                objects.push_back(unit.object);
+            }
         }
 
         // determine output name
-        std::string output;
-        switch (target.type) {
-            case TargetType::Executable:
-                output = target.name;
-                break;
-            case TargetType::Library:
-            case TargetType::StaticLibrary:
-                output = "lib" + target.name + ".a";
-                break;
-            case TargetType::SharedLibrary:
-#ifdef __APPLE__
-                output = "lib" + target.name + ".dylib";
-#else
-                output = "lib" + target.name + ".so";
-#endif
-                break;
-            default:
-                continue;
+        std::string output = get_output_name(target);
+        if (output.empty()) {
+            continue;
         }
         
         all_outputs.push_back(output);
 
         make << "# Target: " << target.name << "\n";
         
-        // target rule
+        // target rule, internal libraries are prerequisites of links so
+        // parallel make runs them only after the libraries exist
+        if (target.type == TargetType::Object) {
+            make << ".PHONY: " << output << "\n";
+        }
         make << output << ":";
         for (const auto& obj : objects) {
             make << " " << obj;
         }
+        if (target.type == TargetType::Executable || target.type == TargetType::SharedLibrary) {
+            for (const auto& obj : get_object_inputs(target, build_dir)) {
+                make << " " << obj;
+            }
+            for (const auto& in : get_link_inputs(target)) {
+                make << " " << in;
+            }
+        }
         make << "\n";
 
         switch (target.type) {
             case TargetType::Executable:
+                if (target.test || target.benchmark) {
+                    make << "\t@mkdir -p $(dir $@)\n";
+                }
                 make << "\t@echo \"  LINK    $@\"\n";
-                make << "\t@$(CXX) " << link_flags << " $^ -o $@ " << libs << "\n";
+                make << "\t@$(CXX) " << link_flags << " $(filter %.o,$^) -o $@ " << libs << "\n";
                 break;
             case TargetType::Library:
             case TargetType::StaticLibrary:
@@ -390,24 +661,120 @@ void Engine::generate_makefile(const std::string& build_dir) {
                 break;
             case TargetType::SharedLibrary:
                 make << "\t@echo \"  LINK    $@\"\n";
-                make << "\t@$(CXX) -shared " << link_flags << " $^ -o $@ " << libs << "\n";
+                make << "\t@$(CXX) -shared " << link_flags << " $(filter %.o,$^) -o $@ " << libs << "\n";
+                make << "\t@$(IRIS) interface $@ $@.iface\n";
+                make << "\n";
+
+                // dependents link against the interface, which keeps its
+                // timestamp unless the exported symbols change
+                make << output << ".iface: " << output << "\n";
+                make << "\t@test -f $@ || $(IRIS) interface $< $@\n";
                 break;
             default:
                 break;
         }
         make << "\n";
 
-        // object rules
-        for (size_t i = 0; i < sources.size(); i++) {
-            fs::path src_path(sources[i]);
-            std::string ext = src_path.extension().string();
-            bool is_c = (ext == ".c");
-            std::string compiler = is_c ? "$(CC)" : "$(CXX)";
+        // partial links
+        for (const auto& partition : partitions) {
+            if (partition.objects.size() < 2) continue;
+
+            make << partition.output << ":";
+            for (const auto& obj : partition.objects) {
+                make << " " << obj;
+            }
+            make << "\n";
+            make << "\t@mkdir -p $(dir $@)\n";
+            make << "\t@echo \"  PARTIAL $@\"\n";
+            make << "\t@$(CXX) -r -nostdlib " << get_partial_link_flags(target) << " $^ -o $@\n";
+            make << "\n";
+        }
+
+        // precompiled header
+        auto pch = get_pch(target, build_dir, compile_flags);
+        if (pch && emitted_pch.insert(pch->output).second) {
+            make << pch->output << ": " << pch->header;
+            for (const auto& header : pch->headers) {
+                make << " " << header;
+            }
+            make << "\n";
+            make << "\t@echo \"  PCH     $<\"\n";
+            make << "\t@$(CXX) " << compile_flags << " -x c++-header $< -o $@\n";
+            make << "\n";
+        }
+
+        // object rules, unity objects also list their members since make
+        // has no depfile to discover them. the compile itself records a
+        // stamp and leaves an unchanged object alone, make re-checks the
+        // object's timestamp and skips the relink (early cutoff)
+        std::map<std::string, std::string> batch_of;
+        for (const auto& batch : get_compile_batches(target, units, build_dir)) {
+            std::string compiler = batch.is_c ? "$(CC)" : "$(CXX)";
+            bool use_pch = pch && !batch.is_c;
+
+            make << batch.name << ".stamp:";
+            for (const auto& unit : batch.units) {
+                make << " " << unit.source;
+                batch_of[unit.object] = batch.name;
+            }
+            if (use_pch) {
+                make << " " << pch->output;
+            }
+            make << "\n";
+            make << "\t@mkdir -p $(dir $@)\n";
+            make << "\t@echo \"  " << (batch.is_c ? "CC " : "CXX") << "     " << batch.name << "\"\n";
+            make << "\t@$(IRIS) compile-batch " << batch.name;
+            for (const auto& unit : batch.units) {
+                make << " " << unit.source << "=" << unit.object;
+            }
+            make << " -- " << compiler << " " << compile_flags << (use_pch ? pch->flags : "") << "\n";
+            make << "\t@touch $@\n";
+            make << "\n";
+        }
+
+        for (const auto& unit : units) {
+            std::string compiler = unit.is_c ? "$(CC)" : "$(CXX)";
+            bool use_pch = pch && !unit.is_c;
+            add_to_database(target, unit, compile_flags + (use_pch ? pch->flags : ""));
+
+            std::string compile = "$(IRIS) compile --cache=$(IRIS_CACHE) --root=$(IRIS_ROOT) --remote=$(IRIS_REMOTE) " +
+                                  unit.object + " -- " + compiler + " " +
+                                  compile_flags + (use_pch ? pch->flags : "") +
+                                  " -c " + unit.source + " -o " + unit.object;
+
+            // batched objects come from their batch, or alone if deleted
+            if (batch_of.count(unit.object)) {
+                make << unit.object << ": " << batch_of[unit.object] << ".stamp\n";
+                make << "\t@test -f $@ || " << compile << "\n";
+                make << "\n";
+                continue;
+            }
+
+            make << unit.object << ": " << unit.object << ".stamp\n";
+            make << "\t@test -f $@ || " << compile << "\n";
+            make << "\n";
+
+            CompileCommand command{unit.object, unit.source,
+                                   split_flags(unit.is_c ? get_compiler() : get_cxx_compiler())};
+            auto& args = command.arguments;
+            for (const auto& flag : split_flags(compile_flags + (use_pch ? pch->flags : ""))) {
+                args.push_back(flag);
+            }
+            args.insert(args.end(), {"-c", unit.source, "-o", unit.object});
+            m_compile_commands.push_back(command);
 
-            make << objects[i] << ": ../" << sources[i] << "\n";
+            make << unit.object << ".stamp: " << unit.source;
+            for (const auto& member : unit.members) {
+                make << " ../" << member;
+            }
+            if (use_pch) {
+                make << " " << pch->output;
+            }
+            make << "\n";
             make << "\t@mkdir -p $(dir $@)\n";
-            make << "\t@echo \"  " << (is_c ? "CC" : "CXX") << "     $<\"\n";
-            make << "\t@" << compiler << " " << compile_flags << " -c $< -o $@\n";
+            make << "\t@echo \"  " << (unit.is_c ? "CC" : "CXX") << "     $<\"\n";
+            make << "\t@" << compile << "\n";
+            make << "\t@touch $@\n";
             make << "\n";
         }
     }
@@ -438,6 +805,258 @@ void Engine::generate_makefile(const std::string& build_dir) {
     Terminal::info("Generated", "Makefile");
 }
 
+void Engine::write_compile_commands(const std::string& build_dir) const {
+    std::ofstream out(build_dir + "/" + COMPILE_COMMANDS);
+    for (const auto& command : m_compile_commands) {
+        out << command.object << "\t" << command.source;
+        for (const auto& arg : command.arguments) {
+            out << "\t" << arg;
+        }
+        out << "\n";
+    }
+}
+
+void Engine::write_tests(const std::string& build_dir) const {
+    std::string root = m_config.source_root.empty()
+                     ? fs::absolute(build_dir).lexically_normal().parent_path().string() : m_config.source_root;
+
+    std::ostringstream json;
+    json << "{\n  \"tests\": [";
+    bool first = true;
+    for (const auto& target : m_config.targets) {
+        if (!target.test) continue;
+        std::string dir = target.test_dir.empty() ? root : (fs::path(root) / target.test_dir).lexically_normal().string();
+        json << (first ? "\n" : ",\n");
+        json << "    {\n";
+        json << "      \"name\": \"" << util::json::escape(target.name) << "\",\n";
+        json << "      \"executable\": \"" << util::json::escape(get_output_name(target)) << "\",\n";
+        json << "      \"args\": [";
+        for (size_t i = 0; i < target.test_args.size(); i++) {
+            json << (i ? ", \"" : "\"") << util::json::escape(target.test_args[i]) << "\"";
+        }
+        json << "],\n      \"env\": {";
+        bool first_env = true;
+        for (const auto& [name, value] : target.test_env) {
+            json << (first_env ? "\"" : ", \"") << util::json::escape(name) << "\": \""
+                 << util::json::escape(value) << "\"";
+            first_env = false;
+        }
+        json << "},\n";
+        json << "      \"working_dir\": \"" << util::json::escape(dir) << "\",\n";
+        json << "      \"timeout\": " << target.test_timeout << ",\n";
+        json << "      \"split_cases\": " << (target.test_split ? "true" : "false") << ",\n";
+        json << "      \"data\": [";
+        for (size_t i = 0; i < target.test_data.size(); i++) {
+            std::string path = (fs::path(root) / target.test_data[i]).lexically_normal().string();
+            json << (i ? ", \"" : "\"") << util::json::escape(path) << "\"";
+        }
+        json << "],\n      \"libraries\": [";
+
+        // every internal shared library the test loads, including those
+        // only other shared libraries link
+        std::set<std::string> visited;
+        bool first_library = true;
+        std::function<void(const Target&)> visit = [&](const Target& current) {
+            for (const auto& dep_name : current.dependencies) {
+                auto it = std::find_if(m_config.targets.begin(), m_config.targets.end(),
+                    [&dep_name](const Target& t) { return t.name == dep_name; });
+                if (it == m_config.targets.end() || !visited.insert(dep_name).second) {
+                    continue;
+                }
+                if (it->type == TargetType::SharedLibrary) {
+                    json << (first_library ? "\"" : ", \"") << util::json::escape(get_output_name(*it)) << "\"";
+                    first_library = false;
+                }
+                visit(*it);
+            }
+        };
+        visit(target);
+        json << "]\n";
+        json << "    }";
+        first = false;
+    }
+    json << "\n  ]\n}\n";
+    util::fs::write_file(build_dir + "/" + TESTS_FILE, json.str());
+}
+
+void Engine::write_benchmarks(const std::string& build_dir) const {
+    std::string root = m_config.source_root.empty()
+                     ? fs::absolute(build_dir).lexically_normal().parent_path().string() : m_config.source_root;
+
+    std::ostringstream json;
+    json << "{\n  \"benchmarks\": [";
+    bool first = true;
+    for (const auto& target : m_config.targets) {
+        if (!target.benchmark) continue;
+        std::string dir = target.test_dir.empty() ? root : (fs::path(root) / target.test_dir).lexically_normal().string();
+        json << (first ? "\n" : ",\n");
+        json << "    {\n";
+        json << "      \"name\": \"" << util::json::escape(target.name) << "\",\n";
+        json << "      \"executable\": \"" << util::json::escape(get_output_name(target)) << "\",\n";
+        json << "      \"args\": [";
+        for (size_t i = 0; i < target.test_args.size(); i++) {
+            json << (i ? ", \"" : "\"") << util::json::escape(target.test_args[i]) << "\"";
+        }
+        json << "],\n      \"env\": {";
+        bool first_env = true;
+        for (const auto& [name, value] : target.test_env) {
+            json << (first_env ? "\"" : ", \"") << util::json::escape(name) << "\": \""
+                 << util::json::escape(value) << "\"";
+            first_env = false;
+        }
+        json << "},\n";
+        json << "      \"working_dir\": \"" << util::json::escape(dir) << "\",\n";
+        json << "      \"repetitions\": " << target.bench_repetitions << ",\n";
+        json << "      \"warmup\": " << target.bench_warmup << "\n";
+        json << "    }";
+        first = false;
+    }
+    json << "\n  ]\n}\n";
+    util::fs::write_file(build_dir + "/" + BENCHMARKS_FILE, json.str());
+}
+
+void Engine::add_to_database(const Target& target, const CompileUnit& unit, const std::string& flags) {
+    std::vector<std::string> base = split_flags(unit.is_c ? get_compiler() : get_cxx_compiler());
+    for (const auto& flag : split_flags(flags)) {
+        base.push_back(flag);
+    }
+
+    // tools look sources up, so a unity file is listed as its members
+    std::vector<std::string> sources;
+    if (unit.members.empty()) {
+        sources.push_back(unit.source);
+    } else {
+        for (const auto& member : unit.members) {
+            sources.push_back("../" + member);
+        }
+    }
+
+    auto& entries = m_database[target.name];
+    for (const auto& source : sources) {
+        CompileCommand command{unit.object, source, base};
+        command.arguments.insert(command.arguments.end(), {"-c", source, "-o", unit.object});
+        entries.push_back(std::move(command));
+    }
+}
+
+void Engine::write_database(const std::string& build_dir) const {
+    if (m_config.compdb == "none") {
+        return;
+    }
+
+    std::string directory = fs::absolute(build_dir).lexically_normal().generic_string();
+    while (directory.size() > 1 && directory.back() == '/') directory.pop_back();
+    std::string root = m_config.source_root.empty()
+                     ? fs::path(directory).parent_path().generic_string() : m_config.source_root;
+
+    auto entry = [&](const CompileCommand& command) {
+        std::string file = (fs::path(directory) / command.source).lexically_normal().generic_string();
+        std::string text = "  {\n    \"directory\": \"" + util::json::escape(directory) + "\",\n";
+        text += "    \"file\": \"" + util::json::escape(file) + "\",\n";
+        text += "    \"arguments\": [";
+        for (size_t i = 0; i < command.arguments.size(); i++) {
+            text += (i ? ", \"" : "\"") + util::json::escape(command.arguments[i]) + "\"";
+        }
+        text += "],\n    \"output\": \"" + util::json::escape(command.object) + "\"\n  }";
+        return std::pair<std::string, std::string>(file, text);
+    };
+
+    // files are only rewritten when their contents change, so tools watching
+    // them reload just what a regeneration touched
+    auto write = [](const std::string& path, const std::vector<std::string>& entries) {
+        std::string content = "[\n";
+        for (size_t i = 0; i < entries.size(); i++) {
+            content += entries[i] + (i + 1 < entries.size() ? ",\n" : "\n");
+        }
+        content += "]\n";
+        if (!fs::exists(path) || util::fs::read_file(path) != content) {
+            fs::create_directories(fs::path(path).parent_path());
+            util::fs::write_file(path, content);
+        }
+    };
+
+    std::vector<std::string> all;
+    std::map<std::string, std::vector<std::string>> shards;  // by source directory
+    for (const auto& target : m_config.targets) {
+        auto found = m_database.find(target.name);
+        if (found == m_database.end()) continue;
+        for (const auto& command : found->second) {
+            auto [file, text] = entry(command);
+            all.push_back(text);
+
+            std::string relative = fs::path(file).parent_path().lexically_relative(root).generic_string();
+            if (relative.empty() || relative.compare(0, 2, "..") == 0) relative = "_external";
+            shards[relative].push_back(text);
+        }
+    }
+    write(build_dir + "/compile_commands.json", all);
+
+    // one database per source directory under compdb/, mirroring the tree
+    std::string shard_dir = build_dir + "/" + COMPDB_SHARDS;
+    if (m_config.compdb == "sharded") {
+        std::set<std::string> written;
+        for (const auto& [relative, entries] : shards) {
+            std::string path = (fs::path(shard_dir) / relative / "compile_commands.json").generic_string();
+            write(path, entries);
+            written.insert(fs::path(path).lexically_normal().generic_string());
+        }
+        for (const auto& path : util::fs::list_files(shard_dir, true)) {
+            if (!written.count(fs::path(path).lexically_normal().generic_string())) {
+                util::fs::remove_file(path);
+            }
+        }
+    } else {
+        util::fs::remove_all(shard_dir);
+    }
+}
+
+void Engine::prefetch(int jobs) {
+    m_prefetch_count = 0;
+
+    // objects that are missing or older than their source are about to be
+    // compiled. header changes are not seen here, those compiles still ask
+    // the remote themselves
+    std::vector<CompileCommand> stale;
+    for (auto& command : read_compile_commands(m_build_dir)) {
+        std::string object = m_build_dir + "/" + command.object;
+        if (!fs::exists(object) || util::fs::is_newer(m_build_dir + "/" + command.source, object)) {
+            stale.push_back(std::move(command));
+        }
+    }
+    if (stale.empty()) {
+        return;
+    }
+
+    // keys need the preprocessor, so this runs as wide as the build
+    Cache cache(m_config.cache_dir);
+    cache.set_remote(m_config.remote_cache);
+    std::atomic<size_t> next{0};
+    std::atomic<int> fetched{0};
+    std::vector<std::thread> workers;
+
+    for (int i = 0; i < jobs && static_cast<size_t>(i) < stale.size(); i++) {
+        workers.emplace_back([&]() {
+            for (size_t item; (item = next++) < stale.size();) {
+                const auto& command = stale[item];
+                try {
+                    std::string key = cache_key(command.object, command.arguments,
+                                                m_config.source_root, m_build_dir);
+                    if (!key.empty() && !cache.contains(key) && cache.fetch(key)) {
+                        fetched++;
+                    }
+                } catch (const std::exception&) {
+                    // the compile will find out for itself
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    m_prefetch_count = fetched;
+}
+
 int Engine::build(const std::string& target,
                   int jobs,
                   bool verbose,
@@ -460,6 +1079,26 @@ int Engine::build(const std::string& target,
         throw std::runtime_error("No build files found in " + m_build_dir);
     }
 
+    // compile steps append outputs they left untouched
+    util::fs::remove_file(m_build_dir + "/" + CUTOFF_LOG);
+    m_cutoff_count = 0;
+    m_prefetch_count = 0;
+    m_upload_count = 0;
+
+    // pins __DATE__ and __TIME__ for every compile the backend starts
+    if (!m_config.source_date_epoch.empty()) {
+#ifdef _WIN32
+        _putenv_s("SOURCE_DATE_EPOCH", m_config.source_date_epoch.c_str());
+#else
+        setenv("SOURCE_DATE_EPOCH", m_config.source_date_epoch.c_str(), 1);
+#endif
+    }
+
+    bool remote = !m_config.remote_cache.empty() && !m_config.cache_dir.empty();
+    if (remote) {
+        prefetch(jobs);
+    }
+
     std::string cmd;
     
     if (has_ninja) {
@@ -482,6 +1121,26 @@ int Engine::build(const std::string& target,
     if (!pipe) {
         throw std::runtime_error("Failed to run build command");
     }
+
+    // compiles only queue their new entries, these upload them while the
+    // build goes on
+    std::optional<Cache> uploads;
+    std::atomic<bool> building{true};
+    std::atomic<int> uploaded{0};
+    std::vector<std::thread> uploaders;
+    if (remote) {
+        uploads.emplace(m_config.cache_dir);
+        uploads->set_remote(m_config.remote_cache);
+        for (int i = 0; i < 4; i++) {
+            uploaders.emplace_back([&]() {
+                while (building) {
+                    uploaded += static_cast<int>(uploads->push());
+                    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                }
+                uploaded += static_cast<int>(uploads->push());
+            });
+        }
+    }
     
     std::regex ninja_re(R"(\[(\d+)/(\d+)\]\s+(\S+)\s+(.+))");
     std::string error_output;
@@ -569,16 +1228,96 @@ int Engine::build(const std::string& target,
     
     int status = pclose(pipe);
     int result = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+    building = false;
+    for (auto& uploader : uploaders) {
+        uploader.join();
+    }
+    m_upload_count = uploaded;
     
     // clear progress line
     std::cout << "\r\033[K";
+
+    m_cutoff_count = count_cutoffs(m_build_dir);
     
     return result;
 }
+
+std::vector<DeterminismResult> Engine::check_determinism(const std::string& target,
+                                                         int sample,
+                                                         int jobs) {
+    if (m_build_dir.empty()) {
+        m_build_dir = "build";
+    }
+    if (jobs <= 0) {
+        jobs = static_cast<int>(std::thread::hardware_concurrency());
+        if (jobs == 0) jobs = 4;
+    }
+
+    std::vector<CompileCommand> commands;
+    for (auto& command : read_compile_commands(m_build_dir)) {
+        std::string prefix = "obj/" + target + "/";
+        bool selected = target.empty() || command.object.compare(0, prefix.size(), prefix) == 0;
+        if (selected && fs::exists(m_build_dir + "/" + command.object)) {
+            commands.push_back(std::move(command));
+        }
+    }
+    if (sample > 0 && commands.size() > static_cast<size_t>(sample)) {
+        std::shuffle(commands.begin(), commands.end(), std::mt19937(std::random_device{}()));
+        commands.resize(sample);
+    }
+    if (commands.empty()) {
+        return {};
+    }
+
+    // __TIME__ has a resolution of one second, make sure the clock moved on
+    // since the newest object was written
+    int64_t newest = 0;
+    for (const auto& command : commands) {
+        newest = std::max(newest, util::fs::modification_time(m_build_dir + "/" + command.object));
+    }
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    if (std::chrono::duration_cast<std::chrono::seconds>(now).count() <= newest) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    // the checkout's own paths, which keep objects from being shared
+    std::vector<std::string> roots;
+    for (const auto& root : {m_config.source_root, fs::absolute(m_build_dir).lexically_normal().string()}) {
+        std::string path = root;
+        while (path.size() > 1 && path.back() == '/') path.pop_back();
+        if (!path.empty()) roots.push_back(path);
+    }
+
+    std::vector<DeterminismResult> results(commands.size());
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> workers;
+    for (int i = 0; i < jobs && static_cast<size_t>(i) < commands.size(); i++) {
+        workers.emplace_back([&]() {
+            for (size_t item; (item = next++) < commands.size();) {
+                std::string scratch = std::string(DETERMINISM_DIR) + "/" + std::to_string(item);
+                results[item] = core::check_determinism(commands[item].object, commands[item].arguments,
+                                                        m_build_dir, scratch, roots);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    util::fs::remove_all(m_build_dir + "/" + DETERMINISM_DIR);
+
+    std::sort(results.begin(), results.end(),
+              [](const DeterminismResult& a, const DeterminismResult& b) { return a.object < b.object; });
+    return results;
+}
 std::vector<std::string> Engine::resolve_sources(const Target& target) const {
+    return resolve_paths(target.sources);
+}
+
+std::vector<std::string> Engine::resolve_paths(const std::vector<std::string>& patterns) const {
     std::vector<std::string> result;
 
-    for (const auto& pattern : target.sources) {
+    for (const auto& pattern : patterns) {
         if (pattern.find('*') != std::string::npos) {
             // glob pattern
             auto files = expand_glob(pattern);
@@ -606,6 +1345,443 @@ std::vector<std::string> Engine::resolve_sources(const Target& target) const {
 
     return unique;
 }
+std::string Engine::get_object_name(const Target& target, const std::string& src) const {
+    fs::path src_path(src);
+    std::string obj_name = src_path.stem().string();
+    
+    // handle duplicate filenames from different directories
+    std::string rel_path = src;
+    std::replace(rel_path.begin(), rel_path.end(), '/', '_');
+    std::replace(rel_path.begin(), rel_path.end(), '\\', '_');
+    if (rel_path.length() > 50) {
+        // Use hash for very long paths
+        obj_name = obj_name + "_" + util::hash::xxhash(src).substr(0, 8);
+    } else {
+        obj_name = fs::path(rel_path).stem().string();
+    }
+    
+    return "obj/" + target.name + "/" + obj_name + ".o";
+}
+
+std::vector<CompileUnit> Engine::get_compile_units(const Target& target,
+                                                   const std::string& build_dir) const {
+    std::vector<CompileUnit> units;
+    auto sources = resolve_sources(target);
+
+    bool unity = target.unity || m_config.unity;
+    int batch_size = target.unity_batch_size > 0 ? target.unity_batch_size : 8;
+
+    auto is_excluded = [&target](const std::string& src) {
+        std::string normalized = fs::path(src).lexically_normal().string();
+        for (const auto& pattern : target.unity_exclude) {
+            if (fs::path(pattern).lexically_normal().string() == normalized ||
+                util::fs::matches_glob(normalized, pattern)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // module interfaces compile like any source but never join a unity file
+    std::set<std::string> interfaces;
+    for (const auto& src : resolve_paths(target.modules)) {
+        std::string normalized = fs::path(src).lexically_normal().string();
+        if (interfaces.insert(normalized).second) {
+            CompileUnit unit;
+            unit.source = "../" + src;
+            unit.object = get_object_name(target, src);
+            units.push_back(unit);
+        }
+    }
+
+    // sources that stay standalone vs. candidates per language
+    std::vector<std::string> c_sources;
+    std::vector<std::string> cxx_sources;
+
+    for (const auto& src : sources) {
+        if (interfaces.count(fs::path(src).lexically_normal().string())) {
+            continue;
+        }
+
+        std::string ext = fs::path(src).extension().string();
+        bool is_c = (ext == ".c");
+        bool is_cxx = (ext == ".cpp" || ext == ".cc" || ext == ".cxx" || ext == ".c++");
+
+        if (unity && (is_c || is_cxx) && !is_excluded(src)) {
+            (is_c ? c_sources : cxx_sources).push_back(src);
+            continue;
+        }
+
+        CompileUnit unit;
+        unit.source = "../" + src;
+        unit.object = get_object_name(target, src);
+        unit.is_c = is_c;
+        units.push_back(unit);
+    }
+
+    if (!unity) {
+        return units;
+    }
+
+    std::string unity_dir = build_dir + "/unity/" + target.name;
+    std::set<std::string> written;
+
+    auto bundle = [&](const std::vector<std::string>& group, bool is_c) {
+        if (group.empty()) return;
+
+        // bucket count is a power of two so growing the target only ever
+        // splits buckets, and each source lands by the hash of its path so
+        // adding a file touches a single bucket
+        size_t wanted = (group.size() + batch_size - 1) / batch_size;
+        size_t bucket_count = 1;
+        while (bucket_count < wanted) bucket_count <<= 1;
+
+        std::vector<std::vector<std::string>> buckets(bucket_count);
+        for (const auto& src : group) {
+            std::string normalized = fs::path(src).lexically_normal().generic_string();
+            buckets[util::hash::fast_hash(normalized) % bucket_count].push_back(src);
+        }
+
+        std::string lang = is_c ? "c" : "cxx";
+        for (size_t i = 0; i < bucket_count; i++) {
+            auto& members = buckets[i];
+            if (members.empty()) continue;
+            std::sort(members.begin(), members.end());
+
+            // a lone source compiles as itself and keeps its usual object
+            if (members.size() == 1) {
+                CompileUnit unit;
+                unit.source = "../" + members[0];
+                unit.object = get_object_name(target, members[0]);
+                unit.is_c = is_c;
+                units.push_back(unit);
+                continue;
+            }
+
+            std::string name = "unity_" + lang + "_" + std::to_string(i) + (is_c ? ".c" : ".cpp");
+            std::string path = unity_dir + "/" + name;
+
+            std::stringstream content;
+            content << "// Generated by Iris Build System, do not edit\n";
+            for (const auto& member : members) {
+                fs::path rel = fs::absolute(member).lexically_relative(fs::absolute(unity_dir));
+                content << "#include \"" << rel.generic_string() << "\"\n";
+            }
+
+            // rewrite only on change so untouched buckets keep their mtime
+            fs::create_directories(unity_dir);
+            if (!fs::exists(path) || util::fs::read_file(path) != content.str()) {
+                util::fs::write_file(path, content.str());
+            }
+            written.insert(name);
+
+            CompileUnit unit;
+            unit.source = "unity/" + target.name + "/" + name;
+            unit.object = "obj/" + target.name + "/unity_" + lang + "_" + std::to_string(i) + ".o";
+            unit.is_c = is_c;
+            unit.members = members;
+            units.push_back(unit);
+        }
+    };
+
+    bundle(c_sources, true);
+    bundle(cxx_sources, false);
+
+    // drop buckets left over from a previous layout
+    if (fs::exists(unity_dir)) {
+        for (const auto& entry : fs::directory_iterator(unity_dir)) {
+            if (!written.count(entry.path().filename().string())) {
+                fs::remove(entry.path());
+            }
+        }
+    }
+
+    return units;
+}
+
+std::optional<PrecompiledHeader> Engine::get_pch(const Target& target,
+                                                 const std::string& build_dir,
+                                                 const std::string& compile_flags) const {
+    if (target.pch.empty()) {
+        return std::nullopt;
+    }
+
+    // only c++ objects use it, a target of c sources has nothing to build it for
+    auto sources = resolve_sources(target);
+    if (std::all_of(sources.begin(), sources.end(),
+                    [](const std::string& src) { return fs::path(src).extension() == ".c"; })) {
+        return std::nullopt;
+    }
+
+    // every pch dir sits at the same depth, so includes can be made relative
+    // before the key is known
+    fs::path pch_base = fs::absolute(build_dir) / "pch" / "_";
+    auto include_path = [&pch_base](const std::string& header) {
+        return fs::absolute(header).lexically_normal().lexically_relative(pch_base).generic_string();
+    };
+
+    PrecompiledHeader pch;
+    std::stringstream content;
+    std::string name;
+
+    content << "// Generated by Iris Build System, do not edit\n";
+
+    if (target.pch == "auto") {
+        auto headers = stable_pch_headers(target, build_dir, select_pch_headers(target, build_dir));
+        if (headers.empty()) {
+            return std::nullopt;
+        }
+
+        name = "auto_pch.hpp";
+        for (const auto& header : headers) {
+            if (header.front() == '<') {
+                content << "#include " << header << "\n";
+            } else {
+                content << "#include \"" << include_path(header) << "\"\n";
+                pch.headers.push_back(fs::path(header).is_absolute() ? header : "../" + header);
+            }
+        }
+    } else {
+        if (!fs::exists(target.pch)) {
+            ui::Terminal::warning("Precompiled header not found: " + target.pch);
+            return std::nullopt;
+        }
+
+        name = fs::path(target.pch).filename().string();
+        content << "#include \"" << include_path(target.pch) << "\"\n";
+        pch.headers.push_back("../" + target.pch);
+    }
+
+    // targets whose flags and header match share one pch. the prefix maps
+    // name this checkout and are left out, so the path is the same in every
+    // checkout and the build cache sees identical flags
+    std::stringstream portable;
+    std::stringstream words(compile_flags);
+    std::string word;
+    while (words >> word) {
+        if (word.rfind("-ffile-prefix-map=", 0) != 0 && word.rfind("-fdebug-prefix-map=", 0) != 0) {
+            portable << word << " ";
+        }
+    }
+    std::string key = util::hash::xxhash(content.str() + "\n" + get_cxx_compiler() + " " +
+                                         portable.str()).substr(0, 12);
+    std::string dir = "pch/" + key;
+
+    pch.header = dir + "/" + name;
+    if (is_clang()) {
+        pch.output = pch.header + ".pch";
+        pch.flags = "-include-pch " + pch.output + " ";
+    } else {
+        pch.output = pch.header + ".gch";
+        pch.flags = "-include " + pch.header + " -Winvalid-pch ";
+    }
+
+    std::string header_path = build_dir + "/" + pch.header;
+    fs::create_directories(build_dir + "/" + dir);
+    if (!fs::exists(header_path) || util::fs::read_file(header_path) != content.str()) {
+        util::fs::write_file(header_path, content.str());
+    }
+
+    return pch;
+}
+
+std::vector<std::string> Engine::stable_pch_headers(const Target& target,
+                                                    const std::string& build_dir,
+                                                    const std::vector<std::string>& selected) const {
+    // the selection goes into the flags of every object of the target, so a
+    // setup keeps the previous one unless more than a quarter of it changed
+    // or one of its project headers is gone
+    std::string path = build_dir + "/pch/" + target.name + ".auto";
+    std::vector<std::string> previous;
+    std::stringstream lines(util::fs::read_file(path));
+    for (std::string line; std::getline(lines, line);) {
+        if (!line.empty()) previous.push_back(line);
+    }
+
+    bool present = std::all_of(previous.begin(), previous.end(), [](const std::string& header) {
+        return header.front() == '<' || fs::exists(header);
+    });
+    std::set<std::string> before(previous.begin(), previous.end());
+    std::set<std::string> after(selected.begin(), selected.end());
+    size_t changed = 0;
+    for (const auto& header : before) changed += after.count(header) ? 0 : 1;
+    for (const auto& header : after) changed += before.count(header) ? 0 : 1;
+
+    if (!previous.empty() && present && changed * 4 <= std::max(before.size(), after.size())) {
+        return previous;
+    }
+
+    std::string content;
+    for (const auto& header : selected) {
+        content += header + "\n";
+    }
+    fs::create_directories(build_dir + "/pch");
+    util::fs::write_file(path, content);
+    return selected;
+}
+
+std::vector<std::string> Engine::select_pch_headers(const Target& target,
+                                                    const std::string& build_dir) const {
+    const size_t max_headers = 16;
+    const auto stable_age = std::chrono::hours(24);
+
+    auto is_header = [](const std::string& path) {
+        std::string ext = fs::path(path).extension().string();
+        return ext.empty() || ext == ".h" || ext == ".hh" || ext == ".hpp" ||
+               ext == ".hxx" || ext == ".inl";
+    };
+
+    // project headers from the depfiles of a previous build, keyed by object
+    std::map<std::string, std::set<std::string>> object_deps;
+    std::string obj_prefix = "obj/" + target.name + "/";
+
+    auto add_dep = [&](const std::string& object, const std::string& dep) {
+        if (object.rfind(obj_prefix, 0) != 0 || !is_header(dep)) return;
+        fs::path path = fs::path(dep).is_absolute() ? fs::path(dep)
+                                                    : (fs::path(build_dir) / dep).lexically_normal();
+        object_deps[object].insert(path.string());
+    };
+
+    if (fs::exists(build_dir + "/.ninja_deps")) {
+        FILE* pipe = popen(("ninja -C " + build_dir + " -t deps 2>/dev/null").c_str(), "r");
+        if (pipe) {
+            std::string object;
+            char buffer[4096];
+            while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
+                std::string line(buffer);
+                while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+                if (line.empty()) continue;
+                if (line[0] != ' ') {
+                    object = line.substr(0, line.find(':'));
+                } else {
+                    add_dep(object, line.substr(line.find_first_not_of(' ')));
+                }
+            }
+            pclose(pipe);
+        }
+    }
+
+    std::string obj_dir = build_dir + "/" + obj_prefix;
+    if (fs::exists(obj_dir)) {
+        for (const auto& entry : fs::directory_iterator(obj_dir)) {
+            if (entry.path().extension() != ".d") continue;
+
+            std::string content = util::fs::read_file(entry.path().string());
+            std::replace(content.begin(), content.end(), '\\', ' ');
+            std::stringstream tokens(content);
+            std::string object = obj_prefix + entry.path().stem().string();
+            std::string token;
+            while (tokens >> token) {
+                if (token.back() != ':') add_dep(object, token);
+            }
+        }
+    }
+
+    std::map<std::string, int> dep_counts;
+    for (const auto& [object, deps] : object_deps) {
+        for (const auto& dep : deps) dep_counts[dep]++;
+    }
+
+    // system headers included at the top level of the sources, these never
+    // change under us so they are always safe candidates
+    std::map<std::string, int> system_counts;
+    int cxx_sources = 0;
+    std::regex include_re(R"(^\s*#\s*include\s*(<[^>]+>))");
+    std::regex if_re(R"(^\s*#\s*if)");
+    std::regex endif_re(R"(^\s*#\s*endif)");
+
+    for (const auto& src : resolve_sources(target)) {
+        if (fs::path(src).extension() == ".c") continue;
+        cxx_sources++;
+
+        std::ifstream file(src);
+        std::set<std::string> seen;
+        std::string line;
+        int depth = 0;
+        while (std::getline(file, line)) {
+            std::smatch match;
+            if (std::regex_search(line, if_re)) {
+                depth++;
+            } else if (std::regex_search(line, endif_re)) {
+                depth = std::max(0, depth - 1);
+            } else if (depth == 0 && std::regex_search(line, match, include_re)) {
+                if (seen.insert(match[1].str()).second) {
+                    system_counts[match[1].str()]++;
+                }
+            }
+        }
+    }
+
+    // keep what at least half the translation units include
+    std::vector<std::pair<int, std::string>> ranked;
+
+    for (const auto& [header, count] : system_counts) {
+        if (count * 2 >= cxx_sources && cxx_sources > 0) {
+            ranked.push_back({count, header});
+        }
+    }
+
+    auto now = fs::file_time_type::clock::now();
+    fs::path root = fs::current_path();
+    for (const auto& [header, count] : dep_counts) {
+        if (count * 2 < static_cast<int>(object_deps.size())) continue;
+
+        fs::path path = fs::absolute(header).lexically_normal();
+        bool in_project = path.lexically_relative(root).string().rfind("..", 0) != 0;
+        std::error_code ec;
+        auto mtime = fs::last_write_time(path, ec);
+        if (ec) continue;
+        if (in_project && now - mtime < stable_age) continue;
+
+        ranked.push_back({count, in_project ? path.lexically_relative(root).string() : path.string()});
+    }
+
+    std::stable_sort(ranked.begin(), ranked.end(),
+        [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    std::vector<std::string> headers;
+    for (const auto& [count, header] : ranked) {
+        if (headers.size() >= max_headers) break;
+        headers.push_back(header);
+    }
+    return headers;
+}
+
+bool Engine::is_clang() const {
+    return get_cxx_compiler().find("clang") != std::string::npos;
+}
+
+bool Engine::uses_modules(const Target& target) const {
+    if (!target.modules.empty()) {
+        return true;
+    }
+
+    // importing from a dependency also needs scanning
+    for (const Target* dep : get_link_deps(target)) {
+        if (!dep->modules.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string Engine::get_bmi_key(const std::string& compile_flags) const {
+    // bmis stay compatible across include paths, defines and warnings, only
+    // the language mode and code generation flags have to match
+    std::stringstream tokens(compile_flags);
+    std::string token;
+    std::string relevant = get_cxx_compiler();
+
+    while (tokens >> token) {
+        if (token.rfind("-std=", 0) == 0 || token.rfind("-f", 0) == 0 ||
+            token.rfind("-m", 0) == 0 || token.rfind("-O", 0) == 0) {
+            relevant += " " + token;
+        }
+    }
+
+    return util::hash::xxhash(relevant).substr(0, 8);
+}
+
 std::vector<std::string> Engine::expand_glob(const std::string& pattern) const {
     std::vector<std::string> result;
     
@@ -779,14 +1955,39 @@ std::string Engine::get_compile_flags(const Target& target) const {
         flags << " ";
     }
 
-    // position independent code for shared libraries
-    if (target.type == TargetType::SharedLibrary) {
+    // position independent code for shared libraries and the object
+    // libraries linked into them
+    if (target.type == TargetType::SharedLibrary ||
+        (target.type == TargetType::Object && linked_into_shared(target))) {
         flags << "-fPIC ";
     }
 
+    // keep the checkout's location out of objects so the build cache can
+    // share them between checkouts and machines. the build dir becomes "."
+    // in debug info, the rest of the source tree relative to its root
+    if (!m_config.cache_dir.empty() && !m_config.source_root.empty() && supports_prefix_map()) {
+        std::string build_dir = fs::absolute(m_build_dir).lexically_normal().string();
+        if (build_dir.size() > 1 && build_dir.back() == '/') build_dir.pop_back();
+        flags << "-ffile-prefix-map=" << m_config.source_root << "/= ";
+        flags << "-fdebug-prefix-map=" << build_dir << "=. ";
+    }
+
     return flags.str();
 }
 
+bool Engine::supports_prefix_map() const {
+    // gcc 8+ and clang 10+, msvc has no equivalent
+    for (const auto& compiler : {get_compiler(), get_cxx_compiler()}) {
+        std::string name = fs::path(compiler).filename().string();
+        bool gnu_like = name == "cc" || name == "c++" ||
+                        name.find("gcc") != std::string::npos ||
+                        name.find("g++") != std::string::npos ||
+                        name.find("clang") != std::string::npos;
+        if (!gnu_like) return false;
+    }
+    return true;
+}
+
 std::string Engine::get_link_flags(const Target& target) const {
     std::stringstream flags;
 
@@ -803,34 +2004,356 @@ std::string Engine::get_link_flags(const Target& target) const {
     return flags.str();
 }
 
-std::string Engine::get_libs(const Target& target) const {
-    std::stringstream libs;
+std::string Engine::get_partial_link_flags(const Target& target) const {
+    // only what picks the linker and the object format, -pie, -static or
+    // libraries would not fit a relocatable output
+    static const std::vector<std::string> prefixes = {
+        "-flto", "-fno-lto", "-fuse-ld=", "--ld-path=", "-B", "--target=", "--sysroot", "-m"
+    };
 
-    // link against dependencies
-    for (const auto& dep_name : target.dependencies) {
-        // check if its an internal target
-        bool is_internal = false;
-        for (const auto& t : m_config.targets) {
-            if (t.name == dep_name) {
-                is_internal = true;
-                if (t.type == TargetType::Library || t.type == TargetType::StaticLibrary) {
-                    libs << "lib" << dep_name << ".a ";
-                } else if (t.type == TargetType::SharedLibrary) {
-                    libs << "-L. -l" << dep_name << " ";
-                }
+    std::stringstream flags;
+    for (size_t i = 0; i < target.link_flags.size(); i++) {
+        const std::string& f = target.link_flags[i];
+        if ((f == "-target" || f == "-B" || f == "--sysroot") && i + 1 < target.link_flags.size()) {
+            flags << f << " " << target.link_flags[++i] << " ";
+            continue;
+        }
+        for (const auto& prefix : prefixes) {
+            if (f.compare(0, prefix.size(), prefix) == 0) {
+                flags << f << " ";
                 break;
             }
         }
-        
-        if (!is_internal) {
-            // assume its an external library
-            libs << "-l" << dep_name << " ";
+    }
+    return flags.str();
+}
+
+std::string Engine::get_libs(const Target& target) const {
+    std::stringstream libs;
+    auto link_deps = get_link_deps(target);
+
+    // link against internal libraries, dependents before their dependencies
+    bool any_shared = false;
+    for (const Target* dep : link_deps) {
+        if (dep->type == TargetType::Object) {
+            continue;  // linked as objects
+        } else if (dep->type == TargetType::SharedLibrary) {
+            libs << "-L. -l" << dep->name << " ";
+            any_shared = true;
+        } else {
+            libs << "lib" << dep->name << ".a ";
+        }
+    }
+
+    // internal shared libraries sit in the build directory, next to their
+    // users or one level up from tests and benchmarks. "$$" survives both
+    // ninja and make as a literal "$"
+    if (any_shared) {
+        bool nested = target.test || target.benchmark;
+#if defined(__APPLE__)
+        libs << (nested ? "-Wl,-rpath,@loader_path/.. " : "-Wl,-rpath,@loader_path ");
+#elif !defined(_WIN32)
+        libs << (nested ? "-Wl,-rpath,'$$ORIGIN/..' " : "-Wl,-rpath,'$$ORIGIN' ");
+#endif
+    }
+
+    // external libraries of this target and of the archives it pulls in
+    std::vector<const Target*> owners = {&target};
+    for (const Target* dep : link_deps) {
+        if (dep->type != TargetType::SharedLibrary || dep->dev_shared) {
+            owners.push_back(dep);
+        }
+    }
+
+    std::set<std::string> seen;
+    for (const Target* owner : owners) {
+        for (const auto& dep_name : owner->dependencies) {
+            bool is_internal = std::any_of(m_config.targets.begin(), m_config.targets.end(),
+                [&dep_name](const Target& t) { return t.name == dep_name; });
+
+            if (!is_internal && seen.insert(dep_name).second) {
+                // assume its an external library
+                libs << "-l" << dep_name << " ";
+            }
         }
     }
 
     return libs.str();
 }
 
+std::string Engine::get_output_name(const Target& target) const {
+    switch (target.type) {
+        case TargetType::Executable: {
+            // tests and benchmarks stay out of the build root, where iris
+            // install looks
+            std::string name = target.test ? "tests/" + target.name
+                             : target.benchmark ? "benchmarks/" + target.name : target.name;
+#ifdef _WIN32
+            return name + ".exe";
+#else
+            return name;
+#endif
+        }
+        case TargetType::Library:
+        case TargetType::StaticLibrary:
+            return "lib" + target.name + ".a";
+        case TargetType::SharedLibrary:
+#ifdef __APPLE__
+            return "lib" + target.name + ".dylib";
+#elif defined(_WIN32)
+            return "lib" + target.name + ".dll";
+#else
+            return "lib" + target.name + ".so";
+#endif
+        case TargetType::Object:
+            // phony alias for the target's objects
+            return target.name;
+        default:
+            return "";
+    }
+}
+
+std::vector<const Target*> Engine::get_link_deps(const Target& target) const {
+    std::vector<const Target*> order;
+    std::set<std::string> visited;
+
+    // post order walk, static archives don't record their own dependencies
+    // so the final link has to name everything they reach. libraries made
+    // shared by --dev-shared keep that behaviour so links resolve the same
+    std::function<void(const Target&)> visit = [&](const Target& current) {
+        for (const auto& dep_name : current.dependencies) {
+            auto it = std::find_if(m_config.targets.begin(), m_config.targets.end(),
+                [&dep_name](const Target& t) { return t.name == dep_name; });
+            if (it == m_config.targets.end() || !visited.insert(dep_name).second) {
+                continue;
+            }
+
+            if (it->type == TargetType::Library || it->type == TargetType::StaticLibrary ||
+                it->type == TargetType::Object || it->dev_shared) {
+                visit(*it);
+                order.push_back(&(*it));
+            } else if (it->type == TargetType::SharedLibrary) {
+                order.push_back(&(*it));
+            }
+        }
+    };
+    visit(target);
+
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+std::vector<std::string> Engine::get_link_inputs(const Target& target) const {
+    std::vector<std::string> inputs;
+    for (const Target* dep : get_link_deps(target)) {
+        if (dep->type == TargetType::Object) {
+            continue;  // see get_object_inputs
+        } else if (dep->type == TargetType::SharedLibrary) {
+            inputs.push_back(get_output_name(*dep) + ".iface");
+        } else {
+            inputs.push_back(get_output_name(*dep));
+        }
+    }
+    return inputs;
+}
+
+std::vector<CompileBatch> Engine::get_compile_batches(const Target& target,
+                                                      const std::vector<CompileUnit>& units,
+                                                      const std::string& build_dir) const {
+    std::vector<CompileBatch> batches;
+    if (!target.batch_compile) {
+        return batches;
+    }
+
+    // per object compile times of earlier builds. ninja appends a record
+    // per output of every edge it runs, only the last one per output counts.
+    // the outputs of one edge run share its start, end and command hash (the
+    // command names every output, so other edges never match it), a batch's
+    // time is split evenly among them
+    struct Record {
+        long start;
+        long end;
+        std::string cmdhash;
+    };
+    std::map<std::string, Record> last;
+    std::ifstream log(build_dir + "/.ninja_log");
+    std::string line;
+    while (std::getline(log, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::stringstream fields(line);
+        long start = 0, end = 0;
+        std::string mtime, output, cmdhash;
+        if (fields >> start >> end >> mtime >> output) {
+            fields >> cmdhash;
+            last[output] = {start, end, cmdhash};
+        }
+    }
+
+    std::map<std::tuple<long, long, std::string>, std::vector<std::string>> runs;
+    for (const auto& [output, record] : last) {
+        runs[{record.start, record.end, record.cmdhash}].push_back(output);
+    }
+    std::map<std::string, double> times;
+    for (const auto& [run, outputs] : runs) {
+        for (const auto& output : outputs) {
+            times[output] = double(std::get<1>(run) - std::get<0>(run)) / outputs.size();
+        }
+    }
+
+    // without history, small files are assumed to be cheap
+    auto estimate = [&](const CompileUnit& unit) {
+        auto it = times.find(unit.object);
+        if (it != times.end()) return it->second;
+        std::string path = build_dir + "/" + unit.source;
+        return util::fs::exists(path) && util::fs::file_size(path) < 4096 ? 50.0 : 1e9;
+    };
+
+    // pack cheap units in path order until a batch holds about a second of
+    // work, expensive ones stay on their own and keep their parallelism
+    const double single_limit = 300.0;
+    const double batch_budget = 1000.0;
+    const size_t max_units = 32;
+
+    for (bool is_c : {true, false}) {
+        std::vector<const CompileUnit*> candidates;
+        for (const auto& unit : units) {
+            if (unit.is_c == is_c && unit.members.empty() && estimate(unit) < single_limit) {
+                candidates.push_back(&unit);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(),
+            [](const CompileUnit* a, const CompileUnit* b) { return a->source < b->source; });
+
+        CompileBatch current;
+        std::set<std::string> stems;
+        double cost = 0.0;
+
+        auto flush = [&]() {
+            if (current.units.size() > 1) {
+                current.name = "obj/" + target.name + "/batch_" + (is_c ? "c_" : "cxx_") +
+                               std::to_string(batches.size());
+                current.is_c = is_c;
+                batches.push_back(current);
+            }
+            current = CompileBatch{};
+            stems.clear();
+            cost = 0.0;
+        };
+
+        for (const CompileUnit* unit : candidates) {
+            // objects are named after their source inside the batch
+            std::string stem = fs::path(unit->source).stem().string();
+            double time = estimate(*unit);
+            if (stems.count(stem) || current.units.size() >= max_units ||
+                (!current.units.empty() && cost + time > batch_budget)) {
+                flush();
+            }
+            current.units.push_back(*unit);
+            stems.insert(stem);
+            cost += time;
+        }
+        flush();
+    }
+
+    return batches;
+}
+
+std::vector<LinkPartition> Engine::get_link_partitions(const Target& target,
+                                                      const std::vector<CompileUnit>& units) const {
+    // partitions follow the source tree so an edit stays within its
+    // directory. big directories split into hash buckets, a power of two
+    // of them, so adding files keeps most partitions intact
+    const size_t max_objects = 256;
+
+    // unity files get a group of their own, its key is no directory
+    std::map<std::string, std::vector<const CompileUnit*>> by_dir;
+    for (const auto& unit : units) {
+        std::string dir = unit.members.empty()
+            ? "dir:" + fs::path(unit.source).lexically_normal().parent_path().generic_string()
+            : "unity";
+        by_dir[dir].push_back(&unit);
+    }
+
+    // the readable part of a name may repeat ("a/b" and "a_b"), the hash of
+    // the whole key tells them apart
+    std::set<std::string> taken;
+    std::vector<LinkPartition> partitions;
+    for (const auto& [dir, members] : by_dir) {
+        std::string name = dir == "unity" ? dir : dir.substr(4);
+        while (name.rfind("../", 0) == 0) name = name.substr(3);
+        std::replace(name.begin(), name.end(), '/', '_');
+        if (name.empty() || name == "..") name = "root";
+        name += "-" + util::hash::xxhash(dir).substr(0, 8);
+
+        size_t wanted = (members.size() + max_objects - 1) / max_objects;
+        size_t bucket_count = 1;
+        while (bucket_count < wanted) bucket_count <<= 1;
+
+        std::vector<LinkPartition> buckets(bucket_count);
+        for (const CompileUnit* unit : members) {
+            size_t index = bucket_count == 1 ? 0 : util::hash::fast_hash(unit->object) % bucket_count;
+            buckets[index].objects.push_back(unit->object);
+        }
+
+        for (size_t i = 0; i < bucket_count; i++) {
+            auto& partition = buckets[i];
+            if (partition.objects.empty()) continue;
+
+            if (partition.objects.size() == 1) {
+                partition.output = partition.objects[0];
+            } else {
+                std::string base = "obj/" + target.name + "/partial/" + name +
+                                   (bucket_count > 1 ? "_" + std::to_string(i) : "");
+                partition.output = base + ".o";
+                for (int n = 2; !taken.insert(partition.output).second; n++) {
+                    partition.output = base + "-" + std::to_string(n) + ".o";
+                }
+            }
+            partitions.push_back(partition);
+        }
+    }
+
+    return partitions;
+}
+
+std::vector<std::string> Engine::get_object_inputs(const Target& target,
+                                                   const std::string& build_dir) const {
+    // objects of object libraries go straight into the final link, archives
+    // leave them to whoever links the archive. a shared library, one made by
+    // --dev-shared included, already holds the objects below it, linking
+    // them again would run their initializers twice
+    std::vector<std::string> objects;
+    std::set<std::string> visited;
+    std::function<void(const Target&)> visit = [&](const Target& current) {
+        for (const auto& dep_name : current.dependencies) {
+            auto it = std::find_if(m_config.targets.begin(), m_config.targets.end(),
+                [&dep_name](const Target& t) { return t.name == dep_name; });
+            if (it == m_config.targets.end() || it->type == TargetType::SharedLibrary ||
+                !visited.insert(dep_name).second) {
+                continue;
+            }
+            if (it->type == TargetType::Object) {
+                for (const auto& unit : get_compile_units(*it, build_dir)) {
+                    objects.push_back(unit.object);
+                }
+            }
+            visit(*it);
+        }
+    };
+    visit(target);
+    return objects;
+}
+
+bool Engine::linked_into_shared(const Target& target) const {
+    for (const auto& other : m_config.targets) {
+        if (other.type != TargetType::SharedLibrary) continue;
+        for (const Target* dep : get_link_deps(other)) {
+            if (dep == &target) return true;
+        }
+    }
+    return false;
+}
+
 // dependency tracking
 
 std::vector<std::string> Engine::get_build_order() const {
@@ -861,7 +2384,7 @@ bool Engine::needs_rebuild(const std::string& target_name) const {
     std::string output;
     switch (target->type) {
         case TargetType::Executable:
-            output = m_build_dir + "/" + target->name;
+            output = m_build_dir + "/" + get_output_name(*target);
             break;
         case TargetType::Library:
         case TargetType::StaticLibrary:
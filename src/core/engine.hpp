@@ -5,6 +5,11 @@
 #include <map>
 #include <functional>
 #include <memory>
+#include <optional>
+
+#include "determinism.hpp"
+#include "testing.hpp"
+#include "bench.hpp"
 
 namespace iris::core {
 
@@ -26,6 +31,73 @@ namespace iris::core {
         std::vector<std::string> link_flags;
         std::vector<std::string> dependencies;
         std::map<std::string, std::string> defines;
+
+        // unity (jumbo) builds
+        bool unity = false;
+        int unity_batch_size = 0;
+        std::vector<std::string> unity_exclude;
+
+        std::string pch;  // header to precompile, or "auto"
+
+        std::vector<std::string> modules;  // c++20 module interface sources
+
+        bool dev_shared = false;  // static library built shared by --dev-shared
+
+        bool incremental_link = false;  // link through cached partial (-r) links
+
+        bool batch_compile = false;  // compile small sources several per process
+
+        // test targets are executables built under tests/ and run by iris test,
+        // benchmarks are built under benchmarks/ and run by iris bench. both
+        // take args, env and working_dir
+        bool test = false;
+        bool benchmark = false;
+        std::vector<std::string> test_args;
+        std::map<std::string, std::string> test_env;
+        std::string test_dir;   // working directory relative to the source root
+        int test_timeout = 0;   // seconds, 0 keeps the iris test default
+        std::vector<std::string> test_data;  // files or directories, part of its cache key
+        bool test_split = true;  // googletest and catch2 cases may run in parallel shards
+        int bench_repetitions = 0;  // 0 keeps the iris bench default
+        int bench_warmup = -1;      // -1 keeps the iris bench default
+    };
+
+    // one compiler invocation, either a plain source or a generated unity
+    // file that includes several of them
+    struct CompileUnit {
+        std::string source;                 // relative to the build dir
+        std::string object;                 // relative to the build dir
+        bool is_c = false;
+        std::vector<std::string> members;   // sources rolled into a unity file
+    };
+
+    // a precompiled header shared by every target with identical flags
+    struct PrecompiledHeader {
+        std::string header;   // forwarding header, relative to the build dir
+        std::string output;   // .gch or .pch, relative to the build dir
+        std::string flags;    // added to each object that uses it
+        std::vector<std::string> headers;  // project headers it pulls in, relative to the build dir
+    };
+
+    // small sources of one language compiled by a single compiler process
+    struct CompileBatch {
+        std::string name;                   // obj/<target>/batch_<lang>_<n>, relative to the build dir
+        bool is_c = false;
+        std::vector<CompileUnit> units;
+    };
+
+    // a cached compile exactly as the build file runs it
+    struct CompileCommand {
+        std::string object;                 // relative to the build dir
+        std::string source;                 // relative to the build dir
+        std::vector<std::string> arguments; // compiler first
+    };
+
+    // objects merged with "$cxx -r" into one relocatable object, so a change
+    // only redoes its own partition before the final link
+    struct LinkPartition {
+        std::string output;                 // relative to the build dir
+        std::vector<std::string> objects;   // a single object is used as is
     };
 
     struct Dependency {
@@ -49,6 +121,14 @@ namespace iris::core {
         std::vector<std::string> global_includes;
         std::map<std::string, std::string> global_defines;
 
+        bool unity = false;  // iris setup --unity
+        bool dev_shared = false;  // iris setup --dev-shared
+        std::string cache_dir;    // shared compile cache, empty disables it
+        std::string source_root;  // absolute path of the source tree
+        std::string remote_cache; // http cache behind cache_dir, empty for none
+        std::string source_date_epoch; // exported to compiles, empty leaves it alone
+        std::string compdb = "full";   // compile_commands.json: full, sharded or none
+
         std::vector<Target> targets;
         std::vector<Dependency> dependencies;
 
@@ -76,19 +156,73 @@ namespace iris::core {
 
         const BuildConfig& config() const { return m_config; }
 
+        // rebuilds cached compiles of a finished build (those of target, or
+        // a random sample of at most sample, 0 for all) and compares them
+        // with the objects the build produced
+        std::vector<DeterminismResult> check_determinism(const std::string& target,
+                                                         int sample,
+                                                         int jobs);
+
+        // compiles of the last build whose output did not change
+        int cutoff_count() const { return m_cutoff_count; }
+
+        // entries the last build fetched ahead from and uploaded to the
+        // remote cache
+        int prefetch_count() const { return m_prefetch_count; }
+        int upload_count() const { return m_upload_count; }
+
     private:
         BuildConfig m_config;
         std::string m_build_dir;
+        int m_cutoff_count = 0;
+        int m_prefetch_count = 0;
+        int m_upload_count = 0;
+        std::vector<CompileCommand> m_compile_commands;
+        std::map<std::string, std::vector<CompileCommand>> m_database;  // per target
 
         void generate_ninja(const std::string& build_dir);
         void generate_makefile(const std::string& build_dir);
+        void write_compile_commands(const std::string& build_dir) const;
+        void add_to_database(const Target& target, const CompileUnit& unit, const std::string& flags);
+        void write_database(const std::string& build_dir) const;
+        void write_tests(const std::string& build_dir) const;
+        void write_benchmarks(const std::string& build_dir) const;
+        void prefetch(int jobs);
 
         std::vector<std::string> resolve_sources(const Target& target) const;
+        std::vector<std::string> resolve_paths(const std::vector<std::string>& patterns) const;
+        std::vector<CompileUnit> get_compile_units(const Target& target,
+                                                   const std::string& build_dir) const;
+        std::string get_object_name(const Target& target, const std::string& src) const;
+        std::vector<CompileBatch> get_compile_batches(const Target& target,
+                                                      const std::vector<CompileUnit>& units,
+                                                      const std::string& build_dir) const;
+        std::vector<LinkPartition> get_link_partitions(const Target& target,
+                                                       const std::vector<CompileUnit>& units) const;
+        std::optional<PrecompiledHeader> get_pch(const Target& target,
+                                                 const std::string& build_dir,
+                                                 const std::string& compile_flags) const;
+        std::vector<std::string> select_pch_headers(const Target& target,
+                                                    const std::string& build_dir) const;
+        std::vector<std::string> stable_pch_headers(const Target& target,
+                                                    const std::string& build_dir,
+                                                    const std::vector<std::string>& selected) const;
+        bool is_clang() const;
+        bool uses_modules(const Target& target) const;
+        std::string get_bmi_key(const std::string& compile_flags) const;
         std::string get_compiler() const;
         std::string get_compile_flags(const Target& target) const;
         std::string get_link_flags(const Target& target) const;
+        std::string get_partial_link_flags(const Target& target) const;
     std::string get_libs(const Target& target) const;
+    std::string get_output_name(const Target& target) const;
+    std::vector<const Target*> get_link_deps(const Target& target) const;
+    std::vector<std::string> get_link_inputs(const Target& target) const;
+    std::vector<std::string> get_object_inputs(const Target& target,
+                                               const std::string& build_dir) const;
+    bool linked_into_shared(const Target& target) const;
     std::string get_cxx_compiler() const;
+    bool supports_prefix_map() const;
     std::vector<std::string> expand_glob(const std::string& pattern) const;
     std::vector<std::string> get_build_order() const;
     bool needs_rebuild(const std::string& target_name) const;
@@ -19,6 +19,7 @@ void Graph::build_from_config(const BuildConfig& config) {
             case TargetType::Executable: node.type = "executable"; break;
             case TargetType::Library: node.type = "library"; break;
             case TargetType::SharedLibrary: node.type = "shared_library"; break;
+            case TargetType::Object: node.type = "object_library"; break;
             default: node.type = "target"; break;
         }
 
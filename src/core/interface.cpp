@@ -0,0 +1,85 @@
+#include "interface.hpp"
+#include "../util/elf.hpp"
+#include "../util/fs.hpp"
+#include "../util/hash.hpp"
+
+#include <sstream>
+#include <algorithm>
+#include <vector>
+
+namespace iris::core {
+
+namespace {
+
+const char* type_name(uint8_t type) {
+    switch (type) {
+        case 0: return "notype";
+        case 1: return "object";
+        case 2: return "func";
+        case 6: return "tls";
+        case 10: return "ifunc";
+        default: return "other";
+    }
+}
+
+const char* binding_name(uint8_t binding) {
+    switch (binding) {
+        case 1: return "global";
+        case 2: return "weak";
+        case 10: return "unique";
+        default: return "other";
+    }
+}
+
+} // namespace
+
+std::string shared_interface(const std::string& library) {
+    if (!util::elf::is_elf(library)) {
+        return "hash " + util::hash::hash_file(library) + "\n";
+    }
+
+    util::elf::File elf(library);
+    std::vector<std::string> lines;
+
+    for (const auto& symbol : elf.dynamic_symbols()) {
+        // only what other objects can bind to is part of the interface
+        if (symbol.section == 0 || symbol.binding == util::elf::STB_LOCAL ||
+            (symbol.visibility != util::elf::STV_DEFAULT &&
+             symbol.visibility != util::elf::STV_PROTECTED)) {
+            continue;
+        }
+
+        std::stringstream line;
+        line << symbol.name << symbol.version << " "
+             << type_name(symbol.type) << " " << binding_name(symbol.binding);
+
+        // the size of exported data is baked into users through copy
+        // relocations, code size is not
+        if (symbol.type == 1 || symbol.type == 6) {
+            line << " " << symbol.size;
+        }
+        lines.push_back(line.str());
+    }
+
+    std::sort(lines.begin(), lines.end());
+
+    std::stringstream result;
+    result << "soname " << elf.soname() << "\n";
+    for (const auto& line : lines) {
+        result << line << "\n";
+    }
+    return result.str();
+}
+
+bool update_interface(const std::string& library, const std::string& output) {
+    std::string interface = shared_interface(library);
+
+    if (util::fs::exists(output) && util::fs::read_file(output) == interface) {
+        return false;
+    }
+
+    util::fs::write_file(output, interface);
+    return true;
+}
+
+} // namespace iris::core
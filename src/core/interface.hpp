@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+namespace iris::core {
+
+// text form of what a shared library exports: its soname and every defined,
+// visible dynamic symbol with type, binding, version and (for data) size.
+// files that are not elf fall back to a content hash, so they always differ
+std::string shared_interface(const std::string& library);
+
+// writes the interface of a library to output, leaving the file untouched
+// when it did not change. returns true if it was written
+bool update_interface(const std::string& library, const std::string& output);
+
+} // namespace iris::core
@@ -0,0 +1,182 @@
+#include "modules.hpp"
+#include "../util/fs.hpp"
+#include "../util/json.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace iris::core {
+
+std::vector<ModuleUnit> read_module_units(const std::string& path) {
+    std::vector<ModuleUnit> units;
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::stringstream fields(line);
+        ModuleUnit unit;
+        if (std::getline(fields, unit.object, '\t') &&
+            std::getline(fields, unit.ddi, '\t') &&
+            std::getline(fields, unit.bmi_key, '\t')) {
+            units.push_back(unit);
+        }
+    }
+
+    return units;
+}
+
+void write_module_units(const std::string& path, const std::vector<ModuleUnit>& units) {
+    std::stringstream content;
+    for (const auto& unit : units) {
+        content << unit.object << "\t" << unit.ddi << "\t" << unit.bmi_key << "\n";
+    }
+
+    if (!util::fs::exists(path) || util::fs::read_file(path) != content.str()) {
+        util::fs::write_file(path, content.str());
+    }
+}
+
+namespace {
+
+struct ScannedUnit {
+    ModuleUnit unit;
+    std::vector<std::string> provides;
+    std::vector<std::string> imports;
+};
+
+std::string bmi_path(const std::string& key, const std::string& module, bool clang) {
+    // partitions are spelled "mod:part", keep the file name portable
+    std::string name = module;
+    std::replace(name.begin(), name.end(), ':', '-');
+    return "bmi/" + key + "/" + name + (clang ? ".pcm" : ".gcm");
+}
+
+void write_if_changed(const std::string& path, const std::string& content) {
+    if (!util::fs::exists(path) || util::fs::read_file(path) != content) {
+        util::fs::write_file(path, content);
+    }
+}
+
+} // namespace
+
+void collate_modules(const std::string& units_file,
+                     const std::string& output,
+                     const std::string& format) {
+    bool clang = (format == "clang");
+    auto units = read_module_units(units_file);
+
+    std::vector<ScannedUnit> scanned;
+    std::map<std::pair<std::string, std::string>, std::string> providers;
+    std::map<std::string, std::string> any_provider;
+
+    for (const auto& unit : units) {
+        std::string text = util::fs::read_file(unit.ddi);
+        if (text.empty()) {
+            throw std::runtime_error("Missing module scan result " + unit.ddi);
+        }
+
+        ScannedUnit scan;
+        scan.unit = unit;
+
+        auto doc = util::json::parse(text);
+        for (const auto& rule : doc["rules"].array) {
+            for (const auto& provided : rule["provides"].array) {
+                scan.provides.push_back(provided["logical-name"].as_string());
+            }
+            for (const auto& required : rule["requires"].array) {
+                std::string lookup = required["lookup-method"].as_string();
+                if (lookup == "include-angle" || lookup == "include-quote") {
+                    throw std::runtime_error(unit.object + ": header unit '" +
+                        required["logical-name"].as_string() + "' is not supported");
+                }
+                scan.imports.push_back(required["logical-name"].as_string());
+            }
+        }
+
+        for (const auto& name : scan.provides) {
+            auto key = std::make_pair(unit.bmi_key, name);
+            if (providers.count(key)) {
+                throw std::runtime_error("Module '" + name + "' is provided by both " +
+                                         providers[key] + " and " + unit.object);
+            }
+            providers[key] = unit.object;
+            any_provider[name] = unit.object;
+        }
+
+        scanned.push_back(scan);
+    }
+
+    std::stringstream dyndep;
+    dyndep << "ninja_dyndep_version = 1\n\n";
+
+    for (const auto& scan : scanned) {
+        const auto& key = scan.unit.bmi_key;
+        std::vector<std::string> outputs;
+        std::vector<std::string> inputs;
+        std::stringstream modmap;
+
+        if (!clang) {
+            modmap << "$root .\n";
+        }
+
+        for (const auto& name : scan.provides) {
+            std::string bmi = bmi_path(key, name, clang);
+            outputs.push_back(bmi);
+            fs::create_directories(fs::path(bmi).parent_path());
+
+            if (clang) {
+                modmap << "-x c++-module\n";
+                modmap << "-fmodule-output=" << bmi << "\n";
+            } else {
+                modmap << name << " " << bmi << "\n";
+            }
+        }
+
+        for (const auto& name : scan.imports) {
+            if (!providers.count({key, name})) {
+                if (any_provider.count(name)) {
+                    throw std::runtime_error(scan.unit.object + " imports '" + name +
+                        "' but " + any_provider[name] + " builds it with incompatible flags");
+                }
+                // not ours (e.g. the standard library), the compiler resolves it
+                continue;
+            }
+
+            std::string bmi = bmi_path(key, name, clang);
+            inputs.push_back(bmi);
+
+            if (clang) {
+                modmap << "-fmodule-file=" << name << "=" << bmi << "\n";
+            } else {
+                modmap << name << " " << bmi << "\n";
+            }
+        }
+
+        dyndep << "build " << scan.unit.object;
+        if (!outputs.empty()) {
+            dyndep << " |";
+            for (const auto& out : outputs) dyndep << " " << out;
+        }
+        dyndep << ": dyndep";
+        if (!inputs.empty()) {
+            dyndep << " |";
+            for (const auto& in : inputs) dyndep << " " << in;
+        }
+        dyndep << "\n";
+
+        write_if_changed(scan.unit.object + ".modmap", modmap.str());
+    }
+
+    write_if_changed(output, dyndep.str());
+}
+
+} // namespace iris::core
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace iris::core {
+
+// a scanned translation unit as recorded in build/modules.units
+struct ModuleUnit {
+    std::string object;    // object the unit compiles to
+    std::string ddi;       // p1689 scan result
+    std::string bmi_key;   // hash of the flags that affect bmi compatibility
+};
+
+std::vector<ModuleUnit> read_module_units(const std::string& path);
+void write_module_units(const std::string& path, const std::vector<ModuleUnit>& units);
+
+// reads the p1689 scan results of every unit and writes a ninja dyndep file
+// that orders bmi producers before their consumers, plus a module map next to
+// each object (<object>.modmap) for the compiler. format is "gcc" or "clang".
+// throws std::runtime_error when the module graph cannot be satisfied
+void collate_modules(const std::string& units_file,
+                     const std::string& output,
+                     const std::string& format);
+
+} // namespace iris::core
@@ -0,0 +1,830 @@
+#include "testing.hpp"
+#include "../util/fs.hpp"
+#include "../util/hash.hpp"
+#include "../util/json.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <fstream>
+#include <filesystem>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+extern char** environ;
+#endif
+
+namespace fs = std::filesystem;
+
+namespace iris::core {
+
+namespace {
+
+// seconds a test gets to exit after SIGTERM before its group is killed
+constexpr int KILL_GRACE = 2;
+
+// output of a failing test kept in the junit report
+constexpr size_t REPORT_OUTPUT = 64 * 1024;
+
+// least recorded work worth a shard of its own, in seconds
+constexpr double SHARD_SECONDS = 1.0;
+
+volatile std::sig_atomic_t g_interrupted = 0;
+
+// what a test did with its current key. one that both passed and failed is
+// flaky, and stays flaky when its key changes
+struct Outcome {
+    std::string key;
+    bool passed = false;
+    bool failed = false;
+    bool flaky = false;
+};
+
+std::map<std::string, Outcome> read_outcomes(const std::string& build_dir) {
+    std::map<std::string, Outcome> outcomes;
+    std::ifstream in(build_dir + "/" + TEST_RESULTS);
+    std::string line;
+    while (std::getline(in, line)) {
+        // key passed failed flaky name
+        std::istringstream fields(line);
+        Outcome outcome;
+        std::string name;
+        if (fields >> outcome.key >> outcome.passed >> outcome.failed >> outcome.flaky &&
+            std::getline(fields >> std::ws, name)) {
+            outcomes[name] = outcome;
+        }
+    }
+    return outcomes;
+}
+
+void write_outcomes(const std::string& build_dir, const std::map<std::string, Outcome>& outcomes) {
+    std::string text;
+    for (const auto& [name, outcome] : outcomes) {
+        text += outcome.key + " " + (outcome.passed ? "1" : "0") + " " + (outcome.failed ? "1" : "0") +
+                " " + (outcome.flaky ? "1" : "0") + " " + name + "\n";
+    }
+    std::string path = build_dir + "/" + TEST_RESULTS;
+    util::fs::write_file(path + ".tmp", text);
+    util::fs::move_file(path + ".tmp", path);
+}
+
+// a file, or every file under a directory, in a stable order
+std::string hash_data(const std::string& path) {
+    if (!util::fs::is_directory(path)) {
+        std::string hash = util::hash::hash_file(path);
+        return path + ":" + (hash.empty() ? "missing" : hash) + "\n";
+    }
+    std::vector<std::string> files = util::fs::list_files(path, true);
+    std::sort(files.begin(), files.end());
+    std::string text;
+    for (const auto& file : files) {
+        text += file + ":" + util::hash::hash_file(file) + "\n";
+    }
+    return text;
+}
+
+void on_interrupt(int) {
+    g_interrupted = 1;
+}
+
+std::string log_name(const std::string& name) {
+    std::string file;
+    for (char c : name) {
+        bool keep = std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.';
+        file += keep ? c : '_';
+    }
+    return file + ".log";
+}
+
+std::string seconds_string(double seconds) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.3f", seconds);
+    return buffer;
+}
+
+std::string xml_escape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        switch (c) {
+            case '&': out += "&amp;"; break;
+            case '<': out += "&lt;"; break;
+            case '>': out += "&gt;"; break;
+            case '"': out += "&quot;"; break;
+            default: out += c; break;
+        }
+    }
+    return out;
+}
+
+// test output as cdata: the tail of it, without control characters xml
+// does not allow and with "]]>" split across sections
+std::string cdata(std::string text) {
+    if (text.size() > REPORT_OUTPUT) {
+        text = "[... output truncated ...]\n" + text.substr(text.size() - REPORT_OUTPUT);
+    }
+    std::string out = "<![CDATA[";
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c < 0x20 && c != '\t' && c != '\n' && c != '\r') continue;
+        if (text.compare(i, 3, "]]>") == 0) {
+            out += "]]]]><![CDATA[>";
+            i += 2;
+            continue;
+        }
+        out += text[i];
+    }
+    return out + "]]>";
+}
+
+// runs body for every index below count on up to jobs threads. no new
+// work is handed out after an interrupt
+void parallel_for(size_t count, int jobs, const std::function<void(size_t)>& body) {
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < count && !g_interrupted; i = next++) {
+            body(i);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < std::min(static_cast<size_t>(std::max(1, jobs)), count); i++) {
+        workers.emplace_back(worker);
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+}
+
+// case names from --gtest_list_tests ("Suite." lines followed by indented
+// cases) or catch2's --list-tests (names indented by two, tags further)
+std::vector<std::string> list_cases(const std::string& output, TestRunner::Framework framework) {
+    std::vector<std::string> cases;
+    std::istringstream in(output);
+    std::string line;
+    std::string suite;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (framework == TestRunner::Framework::GoogleTest) {
+            if (line.empty()) continue;
+            if (line[0] != ' ') {
+                suite = line.substr(0, line.find(' '));
+            } else if (!suite.empty()) {
+                std::string name = line.substr(line.find_first_not_of(' '));
+                cases.push_back(suite + name.substr(0, name.find(' ')));
+            }
+        } else if (line.size() > 2 && line.compare(0, 2, "  ") == 0 && line[2] != ' ') {
+            cases.push_back(line.substr(2));
+        } else if (!line.empty() && std::isdigit(static_cast<unsigned char>(line[0])) &&
+                   line.find("test case") != std::string::npos) {
+            // "12 test cases" or "12 matching test cases". long names wrap
+            // onto lines that look like cases of their own, a count that
+            // does not add up leaves the test whole
+            if (std::strtoul(line.c_str(), nullptr, 10) != cases.size()) return {};
+        }
+    }
+    return cases;
+}
+
+// a line of a catch2 --input-file matching just name. catch2 quotes the line
+// and reads it as a test spec, where "," ends a name and "\" escapes. empty
+// when the name cannot be written that way: catch2 trims the line, takes a
+// leading "*" or a trailing one as a wildcard and "exclude:" as a negation
+std::string catch2_spec(const std::string& name) {
+    if (name.empty() || name.front() == ' ' || name.back() == ' ' || name.front() == '*' ||
+        name.back() == '*' || name.compare(0, 8, "exclude:") == 0) {
+        return "";
+    }
+    std::string spec;
+    for (char c : name) {
+        if (c == '\\' || c == '"' || c == ',' || c == '[' || c == ']' || (spec.empty() && c == '#')) {
+            spec += '\\';
+        }
+        spec += c;
+    }
+    return spec;
+}
+
+} // namespace
+
+const char* status_name(TestStatus status) {
+    switch (status) {
+        case TestStatus::Passed: return "passed";
+        case TestStatus::Failed: return "failed";
+        case TestStatus::TimedOut: return "timeout";
+        case TestStatus::Cached: return "cached";
+    }
+    return "failed";
+}
+
+std::vector<TestCase> read_tests(const std::string& build_dir) {
+    std::string path = build_dir + "/" + TESTS_FILE;
+    if (!util::fs::exists(path)) {
+        throw std::runtime_error("No test list in " + build_dir);
+    }
+
+    util::json::Value doc = util::json::parse(util::fs::read_file(path));
+    std::vector<TestCase> tests;
+    const auto& list = doc["tests"];
+    for (size_t i = 0; i < list.size(); i++) {
+        const auto& entry = list[i];
+        TestCase test;
+        test.name = entry["name"].as_string();
+        test.executable = entry["executable"].as_string();
+        for (size_t a = 0; a < entry["args"].size(); a++) {
+            test.args.push_back(entry["args"][a].as_string());
+        }
+        for (const auto& [name, value] : entry["env"].object) {
+            test.env[name] = value.as_string();
+        }
+        test.working_dir = entry["working_dir"].as_string();
+        test.timeout = static_cast<int>(entry["timeout"].as_number());
+        for (size_t d = 0; d < entry["data"].size(); d++) {
+            test.data.push_back(entry["data"][d].as_string());
+        }
+        for (size_t l = 0; l < entry["libraries"].size(); l++) {
+            test.libraries.push_back(entry["libraries"][l].as_string());
+        }
+        test.split = entry["split_cases"].is_null() || entry["split_cases"].as_bool();
+        tests.push_back(std::move(test));
+    }
+    return tests;
+}
+
+std::string test_key(const TestCase& test, const std::string& build_dir) {
+    std::string text = "iris-test-1\n";
+    text += "exe:" + util::hash::hash_file(build_dir + "/" + test.executable) + "\n";
+    for (const auto& library : test.libraries) {
+        text += "lib:" + library + ":" + util::hash::hash_file(build_dir + "/" + library) + "\n";
+    }
+    for (const auto& arg : test.args) {
+        text += "arg:" + arg + "\n";
+    }
+    for (const auto& [name, value] : test.env) {
+        text += "env:" + name + "=" + value + "\n";
+    }
+    text += "dir:" + test.working_dir + "\n";
+    for (const auto& path : test.data) {
+        text += "data:" + hash_data(path);
+    }
+    return util::hash::sha256(text);
+}
+
+std::map<std::string, double> read_durations(const std::string& build_dir) {
+    return read_duration_file(build_dir + "/" + TEST_DURATIONS);
+}
+
+std::map<std::string, double> read_duration_file(const std::string& path) {
+    std::map<std::string, double> durations;
+    std::string text = util::fs::read_file(path);
+
+    size_t start = text.find_first_not_of(" \t\r\n");
+    if (start != std::string::npos && text[start] == '{') {
+        util::json::Value doc = util::json::parse(text);
+        const auto& list = doc["tests"];
+        for (size_t i = 0; i < list.size(); i++) {
+            if (list[i]["status"].as_string() != "cached") {
+                durations[list[i]["name"].as_string()] = list[i]["seconds"].as_number();
+            }
+        }
+        return durations;
+    }
+
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos) continue;
+        try {
+            durations[line.substr(tab + 1)] = std::stod(line.substr(0, tab));
+        } catch (const std::exception&) {
+            // a damaged line only costs that test its place in the schedule
+        }
+    }
+    return durations;
+}
+
+std::vector<TestShard> partition_tests(const std::vector<TestCase>& tests,
+                                       const std::map<std::string, double>& durations,
+                                       int count) {
+    // tests without history are assumed to take as long as the average one
+    double known = 0.0;
+    int known_count = 0;
+    for (const auto& test : tests) {
+        auto found = durations.find(test.name);
+        if (found != durations.end()) {
+            known += found->second;
+            known_count++;
+        }
+    }
+    double fallback = known_count ? known / known_count : 1.0;
+
+    std::vector<std::pair<double, size_t>> order;
+    for (size_t i = 0; i < tests.size(); i++) {
+        auto found = durations.find(tests[i].name);
+        order.push_back({found == durations.end() ? fallback : found->second, i});
+    }
+    // ties are broken by name, never by the order the list came in
+    std::sort(order.begin(), order.end(), [&](const auto& a, const auto& b) {
+        if (a.first != b.first) return a.first > b.first;
+        return tests[a.second].name < tests[b.second].name;
+    });
+
+    // longest processing time first: each test goes to the least loaded
+    // shard, the lowest index among equals
+    std::vector<TestShard> shards(static_cast<size_t>(std::max(1, count)));
+    for (const auto& [seconds, index] : order) {
+        auto lightest = std::min_element(shards.begin(), shards.end(), [](const TestShard& a, const TestShard& b) {
+            return a.predicted < b.predicted;
+        });
+        lightest->tests.push_back(index);
+        lightest->predicted += seconds;
+    }
+    for (auto& shard : shards) {
+        std::sort(shard.tests.begin(), shard.tests.end());
+    }
+    return shards;
+}
+
+std::string partition_key(const std::vector<TestCase>& tests,
+                          const std::map<std::string, double>& durations) {
+    std::vector<std::string> lines;
+    for (const auto& test : tests) {
+        auto found = durations.find(test.name);
+        char seconds[32] = "-";
+        if (found != durations.end()) {
+            std::snprintf(seconds, sizeof(seconds), "%.6f", found->second);
+        }
+        lines.push_back(test.name + "\t" + seconds + "\n");
+    }
+    std::sort(lines.begin(), lines.end());
+
+    std::string text;
+    for (const auto& line : lines) {
+        text += line;
+    }
+    return util::hash::xxhash(text).substr(0, 8);
+}
+
+void record_durations(const std::string& build_dir, const std::vector<TestResult>& results) {
+    auto durations = read_durations(build_dir);
+    for (const auto& result : results) {
+        if (result.status != TestStatus::Cached) {
+            durations[result.name] = result.seconds;
+        }
+    }
+
+    std::string text;
+    for (const auto& [name, seconds] : durations) {
+        text += seconds_string(seconds) + "\t" + name + "\n";
+    }
+    std::string path = build_dir + "/" + TEST_DURATIONS;
+    util::fs::write_file(path + ".tmp", text);
+    util::fs::move_file(path + ".tmp", path);
+}
+
+TestRunner::TestRunner(const std::string& build_dir) : m_build_dir(build_dir) {}
+
+void TestRunner::set_jobs(int jobs) {
+    m_jobs = std::max(1, jobs);
+}
+
+void TestRunner::set_timeout(int seconds) {
+    m_timeout = std::max(0, seconds);
+}
+
+void TestRunner::set_cache(bool enabled) {
+    m_cache = enabled;
+}
+
+void TestRunner::on_result(ResultCallback callback) {
+    m_callback = std::move(callback);
+}
+
+std::vector<TestResult> TestRunner::run(const std::vector<TestCase>& tests) {
+    util::fs::create_directories(m_build_dir + "/" + TEST_LOGS);
+    auto durations = read_durations(m_build_dir);
+
+    g_interrupted = 0;
+#ifndef _WIN32
+    struct sigaction action {};
+    struct sigaction previous_int {};
+    struct sigaction previous_term {};
+    action.sa_handler = on_interrupt;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, &previous_int);
+    sigaction(SIGTERM, &action, &previous_term);
+#else
+    auto previous_int = std::signal(SIGINT, on_interrupt);
+#endif
+
+    std::vector<TestResult> results(tests.size());
+    std::vector<std::string> keys(tests.size());
+    auto outcomes = read_outcomes(m_build_dir);
+    std::mutex lock;
+
+    // records the outcome of a whole test, called with lock held
+    auto finish = [&](size_t i, TestResult result) {
+        if (result.status != TestStatus::Cached && !g_interrupted) {
+            Outcome& outcome = outcomes[tests[i].name];
+            if (outcome.key != keys[i]) {
+                outcome = Outcome{keys[i], false, false, outcome.flaky};
+            }
+            (result.status == TestStatus::Passed ? outcome.passed : outcome.failed) = true;
+            outcome.flaky = outcome.flaky || (outcome.passed && outcome.failed);
+        }
+        result.flaky = outcomes[tests[i].name].flaky;
+        results[i] = result;
+        if (m_callback && !g_interrupted) m_callback(result);
+    };
+
+    // first every test is looked up in the cache, and those left are split
+    // into shards when their framework can list and shard its cases
+    std::vector<std::vector<Unit>> planned(tests.size());
+    parallel_for(tests.size(), m_jobs, [&](size_t i) {
+        const TestCase& test = tests[i];
+        keys[i] = test_key(test, m_build_dir);
+
+        Outcome known;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            known = outcomes[test.name];
+        }
+        if (m_cache && known.key == keys[i] && known.passed && !known.failed && !known.flaky) {
+            TestResult result;
+            result.name = test.name;
+            result.status = TestStatus::Cached;
+            result.exit_code = 0;
+            result.log = std::string(TEST_LOGS) + "/" + log_name(test.name);
+            std::lock_guard<std::mutex> guard(lock);
+            finish(i, result);
+            return;
+        }
+
+        auto found = durations.find(test.name);
+        planned[i] = plan(test, i, found == durations.end() ? -1.0 : found->second);
+    });
+
+    // then the shards run longest first, tests that never ran count as the
+    // longest. the suite then ends with short tests filling the gaps instead
+    // of one slow test running alone
+    std::vector<const Unit*> units;
+    std::vector<size_t> remaining(tests.size());
+    std::vector<std::vector<TestResult>> parts(tests.size());
+    for (size_t i = 0; i < tests.size(); i++) {
+        remaining[i] = planned[i].size();
+        parts[i].resize(planned[i].size());
+        for (const auto& unit : planned[i]) {
+            units.push_back(&unit);
+        }
+    }
+    std::stable_sort(units.begin(), units.end(), [](const Unit* a, const Unit* b) {
+        return a->expected > b->expected;
+    });
+
+    parallel_for(units.size(), m_jobs, [&](size_t u) {
+        const Unit& unit = *units[u];
+        TestResult part = run_one(unit.command, unit.log);
+
+        std::lock_guard<std::mutex> guard(lock);
+        parts[unit.test][unit.index] = part;
+        if (--remaining[unit.test] == 0) {
+            finish(unit.test, merge(tests[unit.test], parts[unit.test]));
+        }
+    });
+
+#ifndef _WIN32
+    sigaction(SIGINT, &previous_int, nullptr);
+    sigaction(SIGTERM, &previous_term, nullptr);
+#else
+    std::signal(SIGINT, previous_int);
+#endif
+    write_outcomes(m_build_dir, outcomes);
+    if (g_interrupted) {
+        throw std::runtime_error("Interrupted, running tests were stopped");
+    }
+    return results;
+}
+
+std::vector<TestRunner::Unit> TestRunner::plan(const TestCase& test, size_t index, double seconds) const {
+    std::string log = std::string(TEST_LOGS) + "/" + log_name(test.name);
+    double expected = seconds < 0 ? 1e300 : seconds;
+    std::vector<Unit> whole = {{index, 0, test, log, expected}};
+
+    // a shard should have at least SHARD_SECONDS of work, tests without
+    // history may use every job
+    int limit = m_jobs;
+    if (seconds >= 0) {
+        limit = std::min(limit, static_cast<int>(seconds / SHARD_SECONDS));
+    }
+    if (!test.split || limit < 2) {
+        return whole;
+    }
+
+    std::string executable = m_build_dir + "/" + test.executable;
+    std::string binary = util::fs::read_file(executable);
+    Framework framework = Framework::None;
+    if (binary.find("GTEST_SHARD_INDEX") != std::string::npos) {
+        framework = Framework::GoogleTest;
+    } else if (binary.find("--list-tests") != std::string::npos &&
+               binary.find("--input-file") != std::string::npos) {
+        framework = Framework::Catch2;
+    }
+    bool shard_flags = binary.find("--shard-count") != std::string::npos;
+    binary.clear();
+    if (framework == Framework::None ||
+        (framework == Framework::Catch2 && !shard_flags && !test.args.empty())) {
+        return whole;
+    }
+
+    // list the cases with the test's own arguments, which may filter them
+    TestCase listing = test;
+    listing.args.push_back(framework == Framework::GoogleTest ? "--gtest_list_tests" : "--list-tests");
+    std::string listing_log = log + ".list";
+    TestResult listed = run_one(listing, listing_log);
+    std::vector<std::string> cases;
+    // catch2 v2 exits with the number of cases it listed
+    if (listed.status == TestStatus::Passed ||
+        (listed.status == TestStatus::Failed && framework == Framework::Catch2)) {
+        cases = list_cases(util::fs::read_file(m_build_dir + "/" + listing_log), framework);
+    }
+    util::fs::remove_file(m_build_dir + "/" + listing_log);
+
+    std::vector<std::string> specs;
+    if (framework == Framework::Catch2 && !shard_flags) {
+        for (const auto& name : cases) {
+            specs.push_back(catch2_spec(name));
+            if (specs.back().empty()) return whole;
+        }
+    }
+
+    int count = std::min(limit, static_cast<int>(cases.size()));
+    if (count < 2) {
+        return whole;
+    }
+
+    std::vector<Unit> units;
+    for (int shard = 0; shard < count; shard++) {
+        Unit unit{index, static_cast<size_t>(shard), test,
+                  log + "." + std::to_string(shard), expected / count};
+        if (framework == Framework::GoogleTest) {
+            unit.command.env["GTEST_TOTAL_SHARDS"] = std::to_string(count);
+            unit.command.env["GTEST_SHARD_INDEX"] = std::to_string(shard);
+        } else if (shard_flags) {
+            unit.command.args.insert(unit.command.args.end(), {
+                "--shard-count", std::to_string(count), "--shard-index", std::to_string(shard)});
+        } else {
+            // older catch2 takes the names of its cases from a file
+            std::string names;
+            for (size_t c = static_cast<size_t>(shard); c < specs.size(); c += static_cast<size_t>(count)) {
+                names += specs[c] + "\n";
+            }
+            std::string file = m_build_dir + "/" + unit.log + ".cases";
+            util::fs::write_file(file, names);
+            unit.command.args.insert(unit.command.args.end(), {
+                "--input-file", fs::absolute(file).lexically_normal().string()});
+        }
+        units.push_back(std::move(unit));
+    }
+    return units;
+}
+
+TestResult TestRunner::merge(const TestCase& test, const std::vector<TestResult>& parts) const {
+    if (parts.size() == 1) {
+        return parts.front();
+    }
+
+    // the worst shard decides, the output of all of them goes into one log
+    TestResult result;
+    result.name = test.name;
+    result.status = TestStatus::Passed;
+    result.exit_code = 0;
+    result.log = std::string(TEST_LOGS) + "/" + log_name(test.name);
+    result.shards = static_cast<int>(parts.size());
+
+    std::string output;
+    for (size_t i = 0; i < parts.size(); i++) {
+        const TestResult& part = parts[i];
+        result.seconds += part.seconds;
+        if (part.status == TestStatus::TimedOut ||
+            (part.status == TestStatus::Failed && result.status == TestStatus::Passed)) {
+            result.status = part.status;
+            result.exit_code = part.exit_code;
+        }
+        output += "=== shard " + std::to_string(i + 1) + "/" + std::to_string(parts.size()) + " (" +
+                  status_name(part.status) + ") ===\n";
+        output += util::fs::read_file(m_build_dir + "/" + part.log);
+        util::fs::remove_file(m_build_dir + "/" + part.log);
+        util::fs::remove_file(m_build_dir + "/" + part.log + ".cases");
+    }
+    util::fs::write_file(m_build_dir + "/" + result.log, output);
+    return result;
+}
+
+TestResult TestRunner::run_one(const TestCase& test, const std::string& log) const {
+    TestResult result;
+    result.name = test.name;
+    result.log = log;
+
+    std::string log_path = m_build_dir + "/" + result.log;
+    std::string executable = fs::absolute(m_build_dir + "/" + test.executable).lexically_normal().string();
+    int timeout = test.timeout > 0 ? test.timeout : m_timeout;
+    auto start = std::chrono::steady_clock::now();
+
+#ifdef _WIN32
+    // no process groups to kill, the timeout is not enforced here
+    std::string command;
+    for (const auto& [name, value] : test.env) {
+        command += "set \"" + name + "=" + value + "\" && ";
+    }
+    if (!test.working_dir.empty()) {
+        command += "cd /d \"" + test.working_dir + "\" && ";
+    }
+    command += "\"" + executable + "\"";
+    for (const auto& arg : test.args) {
+        command += " \"" + arg + "\"";
+    }
+    command += " > \"" + fs::absolute(log_path).string() + "\" 2>&1 < NUL";
+    result.exit_code = std::system(("\"" + command + "\"").c_str());
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    (void)timeout;
+#else
+    // everything the child needs is built before fork, the child only calls
+    // async-signal-safe functions
+    std::vector<std::string> arguments = {executable};
+    arguments.insert(arguments.end(), test.args.begin(), test.args.end());
+    std::vector<char*> argv;
+    for (auto& arg : arguments) argv.push_back(arg.data());
+    argv.push_back(nullptr);
+
+    std::vector<std::string> variables;
+    for (char** entry = environ; *entry; entry++) {
+        std::string variable = *entry;
+        if (!test.env.count(variable.substr(0, variable.find('=')))) {
+            variables.push_back(variable);
+        }
+    }
+    for (const auto& [name, value] : test.env) {
+        variables.push_back(name + "=" + value);
+    }
+    std::vector<char*> envp;
+    for (auto& variable : variables) envp.push_back(variable.data());
+    envp.push_back(nullptr);
+
+    std::string failed_exec = "iris: cannot run " + executable + "\n";
+    std::string failed_chdir = "iris: cannot enter " + test.working_dir + "\n";
+
+    int output = open(log_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    int input = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (output < 0 || input < 0) {
+        if (output >= 0) close(output);
+        if (input >= 0) close(input);
+        throw std::runtime_error("Cannot write " + log_path);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(output);
+        close(input);
+        throw std::runtime_error("Failed to start " + test.name);
+    }
+    if (pid == 0) {
+        // its own process group, so a timeout reaches whatever it spawns
+        setpgid(0, 0);
+        dup2(input, 0);
+        dup2(output, 1);
+        dup2(output, 2);
+        if (!test.working_dir.empty() && chdir(test.working_dir.c_str()) != 0) {
+            ssize_t ignored = write(2, failed_chdir.data(), failed_chdir.size());
+            (void)ignored;
+            _exit(127);
+        }
+        execve(argv[0], argv.data(), envp.data());
+        ssize_t ignored = write(2, failed_exec.data(), failed_exec.size());
+        (void)ignored;
+        _exit(127);
+    }
+    setpgid(pid, pid);  // either side may get there first
+    close(output);
+    close(input);
+
+    // poll without reaping, the zombie keeps the group id from being reused
+    // until the whole group has been killed below
+    using clock = std::chrono::steady_clock;
+    auto deadline = timeout > 0 ? start + std::chrono::seconds(timeout) : clock::time_point::max();
+    clock::time_point kill_at = clock::time_point::max();
+    bool stopping = false;
+    auto delay = std::chrono::milliseconds(1);
+    while (true) {
+        siginfo_t info {};
+        if (waitid(P_PID, static_cast<id_t>(pid), &info, WEXITED | WNOHANG | WNOWAIT) == 0 &&
+            info.si_pid == pid) {
+            break;
+        }
+        auto now = clock::now();
+        if (!stopping && (now >= deadline || g_interrupted)) {
+            result.status = g_interrupted ? TestStatus::Failed : TestStatus::TimedOut;
+            kill(-pid, SIGTERM);
+            kill_at = now + std::chrono::seconds(KILL_GRACE);
+            stopping = true;
+        } else if (now >= kill_at) {
+            kill(-pid, SIGKILL);
+            kill_at = clock::time_point::max();
+        }
+        std::this_thread::sleep_for(delay);
+        delay = std::min(delay * 2, std::chrono::milliseconds(20));
+    }
+    result.seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    // daemons and helpers the test left behind go with it
+    kill(-pid, SIGKILL);
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+    result.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    if (stopping) {
+        return result;
+    }
+#endif
+
+    result.status = result.exit_code == 0 ? TestStatus::Passed : TestStatus::Failed;
+    return result;
+}
+
+void write_junit_report(const std::string& path,
+                        const std::string& suite,
+                        const std::vector<TestResult>& results,
+                        const std::string& build_dir) {
+    int failures = 0, errors = 0;
+    double total = 0.0;
+    for (const auto& result : results) {
+        if (result.status == TestStatus::Failed) failures++;
+        if (result.status == TestStatus::TimedOut) errors++;
+        total += result.seconds;
+    }
+
+    std::ostringstream xml;
+    std::string counts = " tests=\"" + std::to_string(results.size()) + "\" failures=\"" +
+                         std::to_string(failures) + "\" errors=\"" + std::to_string(errors) +
+                         "\" time=\"" + seconds_string(total) + "\"";
+    xml << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    xml << "<testsuites" << counts << ">\n";
+    xml << "  <testsuite name=\"" << xml_escape(suite) << "\"" << counts << ">\n";
+    for (const auto& result : results) {
+        xml << "    <testcase name=\"" << xml_escape(result.name) << "\" classname=\""
+            << xml_escape(suite) << "\" time=\"" << seconds_string(result.seconds) << "\"";
+        if (result.status == TestStatus::Passed || result.status == TestStatus::Cached) {
+            xml << "/>\n";
+            continue;
+        }
+        xml << ">\n";
+        if (result.status == TestStatus::TimedOut) {
+            xml << "      <error type=\"timeout\" message=\"timed out after "
+                << seconds_string(result.seconds) << "s\"/>\n";
+        } else {
+            xml << "      <failure message=\"exited with code " << result.exit_code << "\"/>\n";
+        }
+        xml << "      <system-out>" << cdata(util::fs::read_file(build_dir + "/" + result.log))
+            << "</system-out>\n";
+        xml << "    </testcase>\n";
+    }
+    xml << "  </testsuite>\n";
+    xml << "</testsuites>\n";
+
+    if (!util::fs::write_file(path, xml.str())) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+}
+
+void write_json_report(const std::string& path,
+                       const std::vector<TestResult>& results) {
+    std::ostringstream json;
+    json << "{\n  \"tests\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& result = results[i];
+        json << (i ? ",\n" : "\n");
+        json << "    {\"name\": \"" << util::json::escape(result.name) << "\", "
+             << "\"status\": \"" << status_name(result.status) << "\", "
+             << "\"exit_code\": " << result.exit_code << ", "
+             << "\"seconds\": " << seconds_string(result.seconds) << ", "
+             << "\"shards\": " << result.shards << ", "
+             << "\"log\": \"" << util::json::escape(result.log) << "\"}";
+    }
+    json << "\n  ]\n}\n";
+
+    if (!util::fs::write_file(path, json.str())) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+}
+
+} // namespace iris::core
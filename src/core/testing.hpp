@@ -0,0 +1,138 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace iris::core {
+
+// test targets as setup wrote them, relative to the build dir
+constexpr const char* TESTS_FILE = "tests.json";
+
+// seconds each test took when it last ran, relative to the build dir
+constexpr const char* TEST_DURATIONS = ".iris_test_durations";
+
+// captured output of each test, relative to the build dir
+constexpr const char* TEST_LOGS = "testlogs";
+
+// outcomes per test and cache key, relative to the build dir
+constexpr const char* TEST_RESULTS = ".iris_test_results";
+
+struct TestCase {
+    std::string name;
+    std::string executable;             // relative to the build dir
+    std::vector<std::string> args;
+    std::map<std::string, std::string> env;  // added to the environment iris runs in
+    std::string working_dir;            // absolute
+    int timeout = 0;                    // seconds, 0 uses the runner's
+    std::vector<std::string> data;      // files or directories it reads, absolute
+    std::vector<std::string> libraries; // internal shared libraries, relative to the build dir
+    bool split = true;                  // may run as several shards of its cases
+};
+
+enum class TestStatus { Passed, Failed, TimedOut, Cached };
+
+struct TestResult {
+    std::string name;
+    TestStatus status = TestStatus::Failed;
+    int exit_code = -1;                 // 128 + signal for tests that were killed
+    double seconds = 0.0;
+    std::string log;                    // stdout and stderr, relative to the build dir
+    bool flaky = false;                 // has passed and failed with the same key
+    int shards = 1;                     // processes its cases were split over
+};
+
+// "passed", "failed", "timeout" or "cached"
+const char* status_name(TestStatus status);
+
+// throws std::runtime_error when setup wrote no test list
+std::vector<TestCase> read_tests(const std::string& build_dir);
+
+// hash of everything a run depends on: the executable, the internal shared
+// libraries it loads, its data, arguments, environment and working directory
+std::string test_key(const TestCase& test, const std::string& build_dir);
+
+// recorded durations by test name; results are merged into what is there.
+// cached results keep the duration of the run they stand for
+std::map<std::string, double> read_durations(const std::string& build_dir);
+void record_durations(const std::string& build_dir, const std::vector<TestResult>& results);
+
+// durations from a file in the format above or from a json report, so ci
+// can feed in what every machine measured last time. missing files are empty
+std::map<std::string, double> read_duration_file(const std::string& path);
+
+struct TestShard {
+    std::vector<size_t> tests;          // indices into the partitioned list
+    double predicted = 0.0;             // seconds of test time by the durations
+};
+
+// splits tests into count shards of similar predicted time, longest first
+// onto the least loaded shard. the result depends only on the test names
+// and durations, so machines that agree on those agree on the split
+std::vector<TestShard> partition_tests(const std::vector<TestCase>& tests,
+                                       const std::map<std::string, double>& durations,
+                                       int count);
+
+// short hash of what partition_tests splits by: the test names and their
+// durations. machines that print the same key computed the same split
+std::string partition_key(const std::vector<TestCase>& tests,
+                          const std::map<std::string, double>& durations);
+
+// runs tests as separate process groups, longest first, so the slowest ones
+// do not start last and a timeout can kill everything a test spawned.
+// googletest and catch2 binaries with enough recorded work are split into
+// shards of their cases that run in parallel and report as one test
+class TestRunner {
+public:
+    using ResultCallback = std::function<void(const TestResult&)>;
+
+    enum class Framework { None, GoogleTest, Catch2 };
+
+    explicit TestRunner(const std::string& build_dir);
+
+    void set_jobs(int jobs);
+    void set_timeout(int seconds);      // 0 for none
+
+    // skip tests that passed with the same key and never failed with it.
+    // outcomes are recorded either way
+    void set_cache(bool enabled);
+
+    // called as each test finishes, one at a time
+    void on_result(ResultCallback callback);
+
+    // results come back in the order of tests. an interrupt stops every
+    // running test and throws std::runtime_error
+    std::vector<TestResult> run(const std::vector<TestCase>& tests);
+
+private:
+    std::string m_build_dir;
+    int m_jobs = 1;
+    int m_timeout = 0;
+    bool m_cache = true;
+    ResultCallback m_callback;
+
+    // one process to run, a whole test or a shard of its cases
+    struct Unit {
+        size_t test;                    // index of the test
+        size_t index;                   // shard
+        TestCase command;               // with the shard's arguments and environment
+        std::string log;                // relative to the build dir
+        double expected;                // seconds
+    };
+
+    // seconds is the recorded duration, negative when there is none
+    std::vector<Unit> plan(const TestCase& test, size_t index, double seconds) const;
+    TestResult merge(const TestCase& test, const std::vector<TestResult>& parts) const;
+    TestResult run_one(const TestCase& test, const std::string& log) const;
+};
+
+// reports for ci systems, results in any order
+void write_junit_report(const std::string& path,
+                        const std::string& suite,
+                        const std::vector<TestResult>& results,
+                        const std::string& build_dir);
+void write_json_report(const std::string& path,
+                       const std::vector<TestResult>& results);
+
+} // namespace iris::core
@@ -122,7 +122,7 @@ struct ProjectBlock : Statement {
 
 struct TargetBlock : Statement {
     std::string name;
-    std::string target_type;  // executable, library, shared_library, etc.
+    std::string target_type;  // executable, library, shared_library, object_library, test, benchmark, etc.
     std::shared_ptr<Block> body;
     std::string type_name() const override { return "TargetBlock"; }
 };
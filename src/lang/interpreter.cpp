@@ -676,6 +676,14 @@ void Interpreter::eval_target(const TargetBlock* block) {
         target.type = core::TargetType::Library;
     } else if (block->target_type == "shared_library") {
         target.type = core::TargetType::SharedLibrary;
+    } else if (block->target_type == "object_library") {
+        target.type = core::TargetType::Object;
+    } else if (block->target_type == "test") {
+        target.type = core::TargetType::Executable;
+        target.test = true;
+    } else if (block->target_type == "benchmark") {
+        target.type = core::TargetType::Executable;
+        target.benchmark = true;
     } else {
         target.type = core::TargetType::Executable;
     }
@@ -712,6 +720,68 @@ void Interpreter::eval_target(const TargetBlock* block) {
             }
         }
     }
+    if (auto unity = m_current_env->get("unity")) {
+        target.unity = is_truthy(unity);
+    }
+    if (auto batch = m_current_env->get("unity_batch_size")) {
+        target.unity_batch_size = static_cast<int>(batch->as_number());
+    }
+    if (auto exclude = m_current_env->get("unity_exclude")) {
+        target.unity_exclude = value_to_string_list(exclude);
+    }
+    if (auto pch = m_current_env->get("pch")) {
+        target.pch = pch->as_string();
+    }
+    if (auto modules = m_current_env->get("modules")) {
+        target.modules = value_to_string_list(modules);
+    }
+    if (auto incremental = m_current_env->get("incremental_link")) {
+        target.incremental_link = is_truthy(incremental);
+    }
+    if (auto batch = m_current_env->get("batch_compile")) {
+        target.batch_compile = is_truthy(batch);
+    }
+    if (target.test || target.benchmark) {
+        if (auto args = m_current_env->get("args")) {
+            target.test_args = value_to_string_list(args);
+        }
+        if (auto env = m_current_env->get("env")) {
+            // {"NAME": "value"} or ["NAME=value"]
+            if (env->is_hash()) {
+                for (const auto& [name, value] : std::get<std::map<std::string, IrisValuePtr>>(env->data)) {
+                    target.test_env[name] = value->to_string();
+                }
+            } else {
+                for (const auto& entry : value_to_string_list(env)) {
+                    size_t eq_pos = entry.find('=');
+                    target.test_env[entry.substr(0, eq_pos)] =
+                        eq_pos == std::string::npos ? "" : entry.substr(eq_pos + 1);
+                }
+            }
+        }
+        if (auto dir = m_current_env->get("working_dir")) {
+            target.test_dir = dir->as_string();
+        }
+    }
+    if (target.benchmark) {
+        if (auto repetitions = m_current_env->get("repetitions")) {
+            target.bench_repetitions = static_cast<int>(repetitions->as_number());
+        }
+        if (auto warmup = m_current_env->get("warmup")) {
+            target.bench_warmup = static_cast<int>(warmup->as_number());
+        }
+    }
+    if (target.test) {
+        if (auto timeout = m_current_env->get("timeout")) {
+            target.test_timeout = static_cast<int>(timeout->as_number());
+        }
+        if (auto data = m_current_env->get("data")) {
+            target.test_data = value_to_string_list(data);
+        }
+        if (auto split = m_current_env->get("split_cases")) {
+            target.test_split = is_truthy(split);
+        }
+    }
     
     m_config.targets.push_back(target);
     m_current_env = prev_env;
@@ -734,6 +804,16 @@ void Interpreter::eval_compiler(const CompilerBlock* block) {
         m_config.global_flags.insert(m_config.global_flags.end(),
                                       warning_list.begin(), warning_list.end());
     }
+    if (auto defines = m_current_env->get("defines")) {
+        for (const auto& def : value_to_string_list(defines)) {
+            size_t eq_pos = def.find('=');
+            if (eq_pos != std::string::npos) {
+                m_config.global_defines[def.substr(0, eq_pos)] = def.substr(eq_pos + 1);
+            } else {
+                m_config.global_defines[def] = "";
+            }
+        }
+    }
     if (auto cc = m_current_env->get("cc")) {
         m_config.compiler = cc->as_string();
     }
@@ -10,6 +10,9 @@ const std::map<std::string, TokenType> Lexer::keywords = {
     {"library", TokenType::LIBRARY},
     {"shared_library", TokenType::SHARED_LIBRARY},
     {"static_library", TokenType::STATIC_LIBRARY},
+    {"object_library", TokenType::OBJECT_LIBRARY},
+    {"test", TokenType::TEST},
+    {"benchmark", TokenType::BENCHMARK},
     {"compiler", TokenType::COMPILER},
     {"dependency", TokenType::DEPENDENCY},
     {"task", TokenType::TASK},
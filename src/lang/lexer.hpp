@@ -20,6 +20,9 @@ enum class TokenType {
     LIBRARY,
     SHARED_LIBRARY,
     STATIC_LIBRARY,
+    OBJECT_LIBRARY,
+    TEST,
+    BENCHMARK,
     COMPILER,
     DEPENDENCY,
     TASK,
@@ -52,6 +52,15 @@ StmtPtr Parser::parse_statement() {
     if (match(TokenType::STATIC_LIBRARY)) {
         return parse_target_block("static_library");
     }
+    if (match(TokenType::OBJECT_LIBRARY)) {
+        return parse_target_block("object_library");
+    }
+    if (match(TokenType::TEST)) {
+        return parse_target_block("test");
+    }
+    if (match(TokenType::BENCHMARK)) {
+        return parse_target_block("benchmark");
+    }
     if (match(TokenType::COMPILER)) {
         return parse_compiler_block();
     }
@@ -0,0 +1,358 @@
+#include "compress.hpp"
+#include "fs.hpp"
+
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef IRIS_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace iris::util::compress {
+
+// container layout, all integers little endian:
+//   "\x89IRZ" codec:u8 level:u8 reserved:u16 raw_size:u64
+//   blocks of raw:u32 stored:u32 method:u8 data[stored]
+// method 0 marks a block kept raw because it did not compress
+static const char MAGIC[4] = {'\x89', 'I', 'R', 'Z'};
+static const size_t HEADER_SIZE = 16;
+static const size_t BLOCK_HEADER_SIZE = 9;
+static const size_t BLOCK_SIZE = 256 * 1024;
+
+static const size_t MIN_MATCH = 4;
+static const size_t MAX_OFFSET = 65535;
+static const int HASH_BITS = 16;
+
+static void put_uint(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+static uint64_t get_uint(const unsigned char* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(p[i]) << (8 * i);
+    }
+    return value;
+}
+
+static inline uint32_t read32(const unsigned char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, 4);
+    return value;
+}
+
+static inline uint32_t hash4(uint32_t value) {
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// lz4 style sequences: a token with literal and match length nibbles (15
+// means more length bytes follow), the literals, then a 16 bit offset.
+// the last sequence carries literals only
+static void put_length(std::string& out, size_t length) {
+    while (length >= 255) {
+        out.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+static void emit_sequence(std::string& out, const unsigned char* literals, size_t literal_length,
+                          size_t offset, size_t match_length) {
+    size_t match_code = match_length ? match_length - MIN_MATCH : 0;
+    out.push_back(static_cast<char>((std::min<size_t>(literal_length, 15) << 4) |
+                                    std::min<size_t>(match_code, 15)));
+    if (literal_length >= 15) {
+        put_length(out, literal_length - 15);
+    }
+    out.append(reinterpret_cast<const char*>(literals), literal_length);
+
+    if (match_length) {
+        put_uint(out, offset, 2);
+        if (match_code >= 15) {
+            put_length(out, match_code - 15);
+        }
+    }
+}
+
+// depth is the number of earlier positions tried per hash bucket. depth 1
+// is the fast greedy path that also skips ahead through data that does not
+// match, larger depths walk a hash chain for longer matches
+static std::string lz_compress(const unsigned char* src, size_t size, int depth) {
+    std::string out;
+    out.reserve(size / 2 + 16);
+
+    if (size <= MIN_MATCH) {
+        if (size > 0) emit_sequence(out, src, size, 0, 0);
+        return out;
+    }
+
+    std::vector<int32_t> head(size_t(1) << HASH_BITS, -1);
+    std::vector<int32_t> chain(depth > 1 ? size : 0, -1);
+    size_t limit = size - MIN_MATCH;
+    size_t anchor = 0;
+    size_t i = 0;
+
+    auto insert = [&](size_t pos) {
+        uint32_t h = hash4(read32(src + pos));
+        if (!chain.empty()) chain[pos] = head[h];
+        head[h] = static_cast<int32_t>(pos);
+    };
+
+    while (i <= limit) {
+        uint32_t current = read32(src + i);
+        int32_t candidate = head[hash4(current)];
+        size_t best_length = 0;
+        size_t best_offset = 0;
+
+        for (int tries = depth; candidate >= 0 && i - candidate <= MAX_OFFSET && tries > 0; tries--) {
+            if (read32(src + candidate) == current) {
+                size_t length = MIN_MATCH;
+                while (i + length < size && src[candidate + length] == src[i + length]) {
+                    length++;
+                }
+                if (length > best_length) {
+                    best_length = length;
+                    best_offset = i - candidate;
+                }
+            }
+            candidate = chain.empty() ? -1 : chain[candidate];
+        }
+        insert(i);
+
+        if (best_length >= MIN_MATCH) {
+            emit_sequence(out, src + anchor, i - anchor, best_offset, best_length);
+            size_t end = i + best_length;
+            if (!chain.empty()) {
+                for (size_t pos = i + 1; pos < end && pos <= limit; pos++) {
+                    insert(pos);
+                }
+            }
+            i = end;
+            anchor = end;
+        } else {
+            i += depth > 1 ? 1 : 1 + ((i - anchor) >> 6);
+        }
+    }
+
+    if (anchor < size) {
+        emit_sequence(out, src + anchor, size - anchor, 0, 0);
+    }
+    return out;
+}
+
+static void lz_decompress(const unsigned char* in, size_t size, unsigned char* out, size_t raw) {
+    size_t ip = 0;
+    size_t op = 0;
+
+    auto corrupt = []() { throw std::runtime_error("Corrupt compressed block"); };
+    auto length = [&](size_t base) {
+        if (base == 15) {
+            unsigned char byte;
+            do {
+                if (ip >= size) corrupt();
+                byte = in[ip++];
+                base += byte;
+            } while (byte == 255);
+        }
+        return base;
+    };
+
+    while (op < raw) {
+        if (ip >= size) corrupt();
+        unsigned char token = in[ip++];
+
+        size_t literals = length(token >> 4);
+        if (literals > size - ip || literals > raw - op) corrupt();
+        std::memcpy(out + op, in + ip, literals);
+        ip += literals;
+        op += literals;
+        if (op == raw) break;
+
+        if (ip + 2 > size) corrupt();
+        size_t offset = get_uint(in + ip, 2);
+        ip += 2;
+        size_t match = length(token & 15) + MIN_MATCH;
+        if (offset == 0 || offset > op || match > raw - op) corrupt();
+
+        // byte by byte, matches may overlap their own output
+        for (size_t k = 0; k < match; k++) {
+            out[op + k] = out[op + k - offset];
+        }
+        op += match;
+    }
+
+    if (ip != size) corrupt();
+}
+
+bool available(Codec codec) {
+#ifdef IRIS_HAVE_ZSTD
+    return true;
+#else
+    return codec != Codec::Zstd;
+#endif
+}
+
+std::string codec_name(Codec codec) {
+    switch (codec) {
+        case Codec::None: return "none";
+        case Codec::LZ: return "lz";
+        case Codec::Zstd: return "zstd";
+    }
+    return "unknown";
+}
+
+Codec parse_codec(const std::string& name) {
+    if (name == "none") return Codec::None;
+    if (name == "lz") return Codec::LZ;
+    if (name == "zstd") {
+        if (!available(Codec::Zstd)) {
+            throw std::runtime_error("iris was built without zstd support");
+        }
+        return Codec::Zstd;
+    }
+    throw std::runtime_error("Unknown compression codec: " + name);
+}
+
+Codec default_codec() {
+    return available(Codec::Zstd) ? Codec::Zstd : Codec::LZ;
+}
+
+int level_for_size(Codec codec, uint64_t size) {
+    const uint64_t small = 1024 * 1024;
+    const uint64_t large = 16 * 1024 * 1024;
+
+    if (codec == Codec::Zstd) {
+        return size < small ? 9 : size < large ? 5 : 3;
+    }
+    // lz levels are hash chain depths
+    return size < small ? 32 : size < large ? 8 : 1;
+}
+
+std::string compress(const std::string& data, Codec codec, int level) {
+    if (codec == Codec::None) {
+        return data;
+    }
+    if (!available(codec)) {
+        throw std::runtime_error("Compression codec not available: " + codec_name(codec));
+    }
+
+    std::string out(MAGIC, sizeof(MAGIC));
+    out.push_back(static_cast<char>(codec));
+    out.push_back(static_cast<char>(std::clamp(level, 0, 255)));
+    put_uint(out, 0, 2);
+    put_uint(out, data.size(), 8);
+
+    const unsigned char* src = reinterpret_cast<const unsigned char*>(data.data());
+    for (size_t offset = 0; offset < data.size(); offset += BLOCK_SIZE) {
+        size_t raw = std::min(BLOCK_SIZE, data.size() - offset);
+        std::string block;
+
+        if (codec == Codec::LZ) {
+            block = lz_compress(src + offset, raw, level);
+        }
+#ifdef IRIS_HAVE_ZSTD
+        else if (codec == Codec::Zstd) {
+            block.resize(ZSTD_compressBound(raw));
+            size_t written = ZSTD_compress(&block[0], block.size(), src + offset, raw, level);
+            if (ZSTD_isError(written)) {
+                throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(written));
+            }
+            block.resize(written);
+        }
+#endif
+
+        bool stored_raw = block.size() >= raw;
+        put_uint(out, raw, 4);
+        put_uint(out, stored_raw ? raw : block.size(), 4);
+        out.push_back(static_cast<char>(stored_raw ? Codec::None : codec));
+        if (stored_raw) {
+            out.append(data, offset, raw);
+        } else {
+            out += block;
+        }
+    }
+
+    return out;
+}
+
+uint64_t decompress_file(const std::string& src, const std::string& dest) {
+    std::ifstream in(src, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot open " + src);
+    }
+
+    unsigned char header[HEADER_SIZE];
+    in.read(reinterpret_cast<char*>(header), HEADER_SIZE);
+    if (in.gcount() != static_cast<std::streamsize>(HEADER_SIZE) ||
+        std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0) {
+        // stored without compression
+        in.close();
+        if (!util::fs::copy_file(src, dest, true)) {
+            throw std::runtime_error("Cannot write " + dest);
+        }
+        return util::fs::file_size(dest);
+    }
+
+    std::ofstream out(dest, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Cannot write " + dest);
+    }
+
+    uint64_t expected = get_uint(header + 8, 8);
+    uint64_t total = 0;
+    std::vector<unsigned char> stored;
+    std::vector<unsigned char> raw;
+
+    unsigned char block[BLOCK_HEADER_SIZE];
+    while (in.read(reinterpret_cast<char*>(block), BLOCK_HEADER_SIZE)) {
+        size_t raw_size = get_uint(block, 4);
+        size_t stored_size = get_uint(block + 4, 4);
+        Codec method = static_cast<Codec>(block[8]);
+        if (raw_size > BLOCK_SIZE || stored_size > BLOCK_SIZE) {
+            throw std::runtime_error("Corrupt compressed file " + src);
+        }
+
+        stored.resize(stored_size);
+        in.read(reinterpret_cast<char*>(stored.data()), stored_size);
+        if (in.gcount() != static_cast<std::streamsize>(stored_size)) {
+            throw std::runtime_error("Truncated compressed file " + src);
+        }
+
+        if (method == Codec::None) {
+            if (stored_size != raw_size) {
+                throw std::runtime_error("Corrupt compressed file " + src);
+            }
+            out.write(reinterpret_cast<const char*>(stored.data()), stored_size);
+        } else {
+            raw.resize(raw_size);
+            if (method == Codec::LZ) {
+                lz_decompress(stored.data(), stored_size, raw.data(), raw_size);
+            }
+#ifdef IRIS_HAVE_ZSTD
+            else if (method == Codec::Zstd) {
+                size_t written = ZSTD_decompress(raw.data(), raw_size, stored.data(), stored_size);
+                if (ZSTD_isError(written) || written != raw_size) {
+                    throw std::runtime_error("Corrupt compressed file " + src);
+                }
+            }
+#endif
+            else {
+                throw std::runtime_error(src + " uses a codec this build does not support");
+            }
+            out.write(reinterpret_cast<const char*>(raw.data()), raw_size);
+        }
+        total += raw_size;
+    }
+
+    if (total != expected || !out) {
+        throw std::runtime_error("Truncated compressed file " + src);
+    }
+    return total;
+}
+
+} // namespace iris::util::compress
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+namespace iris::util::compress {
+
+enum class Codec : uint8_t {
+    None = 0,
+    LZ = 1,     // built in, lz4 style byte aligned lz77
+    Zstd = 2    // only when built with IRIS_HAVE_ZSTD
+};
+
+bool available(Codec codec);
+std::string codec_name(Codec codec);
+// "none", "lz" or "zstd", throws std::runtime_error on anything else
+Codec parse_codec(const std::string& name);
+
+// best codec compiled in
+Codec default_codec();
+
+// level for an artifact of the given size: small files get the slow,
+// thorough settings and huge ones the fast path so storing stays cheap
+int level_for_size(Codec codec, uint64_t size);
+
+// wraps data into a framed container of independently compressed blocks
+std::string compress(const std::string& data, Codec codec, int level);
+
+// decodes a container into dest one block at a time, so memory use does
+// not grow with the artifact. files without the container header are copied
+// as they are. returns the number of bytes written, throws
+// std::runtime_error on damaged input
+uint64_t decompress_file(const std::string& src, const std::string& dest);
+
+} // namespace iris::util::compress
@@ -0,0 +1,201 @@
+#include "elf.hpp"
+#include "fs.hpp"
+
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+namespace iris::util::elf {
+
+File::File(const std::string& path) {
+    m_data = util::fs::read_file(path);
+
+    if (m_data.size() < 52 || m_data.compare(0, 4, "\x7f" "ELF") != 0) {
+        throw std::runtime_error(path + " is not an ELF file");
+    }
+
+    m_is64 = (m_data[4] == 2);
+    m_little = (m_data[5] == 1);
+
+    if (m_is64 && m_data.size() < 64) {
+        throw std::runtime_error(path + ": truncated ELF header");
+    }
+
+    uint64_t shoff = m_is64 ? read(0x28, 8) : read(0x20, 4);
+    uint64_t shentsize = m_is64 ? read(0x3A, 2) : read(0x2E, 2);
+    uint64_t shnum = m_is64 ? read(0x3C, 2) : read(0x30, 2);
+    uint64_t shstrndx = m_is64 ? read(0x3E, 2) : read(0x32, 2);
+
+    if (shoff == 0) {
+        return;
+    }
+
+    auto read_header = [this, shoff, shentsize](uint64_t index) {
+        uint64_t base = shoff + index * shentsize;
+        Section section;
+        section.type = static_cast<uint32_t>(read(base + 4, 4));
+        if (m_is64) {
+            section.flags = read(base + 8, 8);
+            section.offset = read(base + 24, 8);
+            section.size = read(base + 32, 8);
+            section.link = static_cast<uint32_t>(read(base + 40, 4));
+            section.entsize = read(base + 56, 8);
+        } else {
+            section.flags = read(base + 8, 4);
+            section.offset = read(base + 16, 4);
+            section.size = read(base + 20, 4);
+            section.link = static_cast<uint32_t>(read(base + 24, 4));
+            section.entsize = read(base + 36, 4);
+        }
+        return std::make_pair(section, static_cast<uint32_t>(read(base, 4)));
+    };
+
+    // large section counts live in the first section header
+    auto first = read_header(0);
+    if (shnum == 0) shnum = first.first.size;
+    if (shstrndx == 0xffff) shstrndx = first.first.link;
+
+    std::vector<uint32_t> names;
+    for (uint64_t i = 0; i < shnum; i++) {
+        auto [section, name] = read_header(i);
+        m_sections.push_back(section);
+        names.push_back(name);
+    }
+
+    if (shstrndx < m_sections.size()) {
+        Section strtab = m_sections[shstrndx];
+        for (size_t i = 0; i < m_sections.size(); i++) {
+            m_sections[i].name = read_string(strtab, names[i]);
+        }
+    }
+}
+
+uint64_t File::read(uint64_t offset, int size) const {
+    if (offset + size > m_data.size()) {
+        throw std::runtime_error("ELF read out of bounds");
+    }
+
+    uint64_t value = 0;
+    for (int i = 0; i < size; i++) {
+        uint64_t byte = static_cast<unsigned char>(m_data[offset + (m_little ? i : size - 1 - i)]);
+        value |= byte << (8 * i);
+    }
+    return value;
+}
+
+std::string File::read_string(const Section& strtab, uint64_t offset) const {
+    uint64_t start = strtab.offset + offset;
+    if (offset >= strtab.size || start >= m_data.size()) {
+        return "";
+    }
+    size_t end = m_data.find('\0', start);
+    if (end == std::string::npos) end = m_data.size();
+    return m_data.substr(start, end - start);
+}
+
+const Section* File::find_section(uint32_t type) const {
+    for (const auto& section : m_sections) {
+        if (section.type == type) return &section;
+    }
+    return nullptr;
+}
+
+std::string File::section_data(const Section& section) const {
+    if (section.type == SHT_NOBITS || section.offset >= m_data.size()) {
+        return "";
+    }
+    return m_data.substr(section.offset, section.size);
+}
+
+std::vector<Symbol> File::dynamic_symbols() const {
+    std::vector<Symbol> symbols;
+
+    const Section* dynsym = find_section(SHT_DYNSYM);
+    if (!dynsym || dynsym->link >= m_sections.size()) {
+        return symbols;
+    }
+    const Section& strtab = m_sections[dynsym->link];
+
+    // version definitions, index -> name
+    std::map<uint16_t, std::string> versions;
+    const Section* verdef = find_section(SHT_GNU_VERDEF);
+    if (verdef && verdef->link < m_sections.size()) {
+        const Section& verstr = m_sections[verdef->link];
+        uint64_t entry = verdef->offset;
+        while (entry < verdef->offset + verdef->size) {
+            uint16_t index = static_cast<uint16_t>(read(entry + 4, 2));
+            uint64_t aux = read(entry + 12, 4);
+            uint64_t next = read(entry + 16, 4);
+            versions[index] = read_string(verstr, read(entry + aux, 4));
+            if (next == 0) break;
+            entry += next;
+        }
+    }
+    const Section* versym = find_section(SHT_GNU_VERSYM);
+
+    uint64_t entsize = dynsym->entsize ? dynsym->entsize : (m_is64 ? 24 : 16);
+    uint64_t count = dynsym->size / entsize;
+
+    for (uint64_t i = 1; i < count; i++) {
+        uint64_t base = dynsym->offset + i * entsize;
+        Symbol symbol;
+        uint8_t info;
+
+        symbol.name = read_string(strtab, read(base, 4));
+        if (m_is64) {
+            info = static_cast<uint8_t>(read(base + 4, 1));
+            symbol.visibility = static_cast<uint8_t>(read(base + 5, 1) & 0x3);
+            symbol.section = static_cast<uint16_t>(read(base + 6, 2));
+            symbol.size = read(base + 16, 8);
+        } else {
+            symbol.size = read(base + 8, 4);
+            info = static_cast<uint8_t>(read(base + 12, 1));
+            symbol.visibility = static_cast<uint8_t>(read(base + 13, 1) & 0x3);
+            symbol.section = static_cast<uint16_t>(read(base + 14, 2));
+        }
+        symbol.binding = info >> 4;
+        symbol.type = info & 0xf;
+
+        if (versym) {
+            // the high bit marks hidden (non default) versions
+            uint16_t index = static_cast<uint16_t>(read(versym->offset + i * 2, 2));
+            auto it = versions.find(index & 0x7fff);
+            if (it != versions.end() && (index & 0x7fff) > 1) {
+                symbol.version = ((index & 0x8000) ? "@" : "@@") + it->second;
+            }
+        }
+
+        symbols.push_back(symbol);
+    }
+
+    return symbols;
+}
+
+std::string File::soname() const {
+    const Section* dynamic = find_section(SHT_DYNAMIC);
+    if (!dynamic || dynamic->link >= m_sections.size()) {
+        return "";
+    }
+
+    int word = m_is64 ? 8 : 4;
+    for (uint64_t entry = dynamic->offset;
+         entry + 2 * word <= dynamic->offset + dynamic->size;
+         entry += 2 * word) {
+        uint64_t tag = read(entry, word);
+        if (tag == 0) break;
+        if (tag == 14) {  // DT_SONAME
+            return read_string(m_sections[dynamic->link], read(entry + word, word));
+        }
+    }
+    return "";
+}
+
+bool is_elf(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[4] = {};
+    file.read(magic, 4);
+    return file.gcount() == 4 && magic[0] == 0x7f &&
+           magic[1] == 'E' && magic[2] == 'L' && magic[3] == 'F';
+}
+
+} // namespace iris::util::elf
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace iris::util::elf {
+
+struct Section {
+    std::string name;
+    uint32_t type = 0;
+    uint64_t flags = 0;
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    uint32_t link = 0;
+    uint64_t entsize = 0;
+};
+
+struct Symbol {
+    std::string name;
+    std::string version;  // empty when the object has no version info
+    uint8_t type = 0;     // STT_*
+    uint8_t binding = 0;  // STB_*
+    uint8_t visibility = 0;
+    uint16_t section = 0; // 0 means undefined
+    uint64_t size = 0;
+};
+
+// section types and symbol attributes used by iris
+constexpr uint32_t SHT_DYNSYM = 11;
+constexpr uint32_t SHT_DYNAMIC = 6;
+constexpr uint32_t SHT_GNU_VERDEF = 0x6ffffffd;
+constexpr uint32_t SHT_GNU_VERSYM = 0x6fffffff;
+constexpr uint32_t SHT_NOBITS = 8;
+
+constexpr uint8_t STB_LOCAL = 0;
+constexpr uint8_t STV_DEFAULT = 0;
+constexpr uint8_t STV_PROTECTED = 3;
+
+// read-only view of an elf file (32/64 bit, either byte order)
+class File {
+public:
+    // throws std::runtime_error if the file is not a readable elf object
+    explicit File(const std::string& path);
+
+    const std::vector<Section>& sections() const { return m_sections; }
+    std::string section_data(const Section& section) const;
+
+    std::vector<Symbol> dynamic_symbols() const;
+    std::string soname() const;
+
+private:
+    std::string m_data;
+    bool m_is64 = false;
+    bool m_little = true;
+    std::vector<Section> m_sections;
+
+    uint64_t read(uint64_t offset, int size) const;
+    std::string read_string(const Section& strtab, uint64_t offset) const;
+    const Section* find_section(uint32_t type) const;
+};
+
+// cheap magic check, does not validate the rest of the file
+bool is_elf(const std::string& path);
+
+} // namespace iris::util::elf
@@ -397,4 +397,16 @@ bool set_current_path(const std::string& path) {
     }
 }
 
+std::string executable_path() {
+    std::error_code ec;
+#if defined(__linux__)
+    auto path = stdfs::read_symlink("/proc/self/exe", ec);
+    if (!ec) return path.string();
+#elif defined(__FreeBSD__)
+    auto path = stdfs::read_symlink("/proc/curproc/file", ec);
+    if (!ec) return path.string();
+#endif
+    return "iris";
+}
+
 } // namespace iris::util::fs
@@ -63,4 +63,7 @@ void walk(const std::string& path, WalkCallback callback, bool follow_symlinks =
 std::string current_path();
 bool set_current_path(const std::string& path);
 
+// absolute path of the running binary, for build files that call back into iris
+std::string executable_path();
+
 } // namespace iris::util::fs
@@ -0,0 +1,416 @@
+#include "http.hpp"
+
+#include <map>
+#include <thread>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+namespace iris::util::http {
+
+namespace {
+
+// longest start line plus headers we accept
+constexpr size_t MAX_HEADER = 64 * 1024;
+
+std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+        [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+std::string reason(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 201: return "Created";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 500: return "Internal Server Error";
+        default: return "Unknown";
+    }
+}
+
+#ifndef _WIN32
+
+// a connection and whatever was read past the current message
+struct Stream {
+    explicit Stream(int fd) : fd(fd) {}
+
+    int fd;
+    std::string buffer;
+    bool closed = false;
+
+    bool fill() {
+        char data[65536];
+        ssize_t n;
+        do {
+            n = recv(fd, data, sizeof(data), 0);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) {
+            closed = true;
+            return false;
+        }
+        buffer.append(data, static_cast<size_t>(n));
+        return true;
+    }
+
+    bool line(std::string& out) {
+        size_t end;
+        while ((end = buffer.find("\r\n")) == std::string::npos) {
+            if (buffer.size() > MAX_HEADER || !fill()) return false;
+        }
+        out = buffer.substr(0, end);
+        buffer.erase(0, end + 2);
+        return true;
+    }
+
+    bool read(size_t size, std::string& out) {
+        while (buffer.size() < size) {
+            if (!fill()) return false;
+        }
+        out.append(buffer, 0, size);
+        buffer.erase(0, size);
+        return true;
+    }
+};
+
+struct Message {
+    std::string start;
+    std::map<std::string, std::string> headers;  // names lowercased
+    std::string body;
+};
+
+bool send_all(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// reads one message. a response without a length runs to the end of the
+// connection, a request without one has no body
+bool read_message(Stream& stream, Message& message, bool has_body, bool is_response) {
+    if (!stream.line(message.start)) {
+        return false;
+    }
+
+    std::string line;
+    size_t total = 0;
+    while (stream.line(line) && !line.empty()) {
+        total += line.size();
+        if (total > MAX_HEADER) return false;
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        size_t value = line.find_first_not_of(" \t", colon + 1);
+        message.headers[lowercase(line.substr(0, colon))] =
+            value == std::string::npos ? "" : line.substr(value);
+    }
+    if (stream.closed) {
+        return false;
+    }
+    if (!has_body) {
+        return true;
+    }
+
+    auto encoding = message.headers.find("transfer-encoding");
+    auto length = message.headers.find("content-length");
+
+    if (encoding != message.headers.end() && lowercase(encoding->second) != "identity") {
+        for (;;) {
+            if (!stream.line(line)) return false;
+            size_t size = std::strtoull(line.c_str(), nullptr, 16);
+            if (size == 0) break;
+            std::string crlf;
+            if (!stream.read(size, message.body) || !stream.read(2, crlf)) return false;
+        }
+        // trailers end with an empty line
+        while (stream.line(line) && !line.empty()) {}
+        return !stream.closed;
+    }
+    if (length != message.headers.end()) {
+        return stream.read(std::strtoull(length->second.c_str(), nullptr, 10), message.body);
+    }
+    if (is_response) {
+        while (stream.fill()) {}
+        message.body = std::move(stream.buffer);
+        stream.buffer.clear();
+    }
+    return true;
+}
+
+void set_timeouts(int fd, int timeout_ms) {
+    timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+void serve_connection(int fd, Handler handler) {
+    Stream stream(fd);
+    set_timeouts(fd, 60000);
+
+    for (;;) {
+        Message message;
+        if (!read_message(stream, message, true, false)) {
+            break;
+        }
+
+        Request request;
+        size_t space = message.start.find(' ');
+        size_t second = message.start.find(' ', space + 1);
+        if (space == std::string::npos || second == std::string::npos) {
+            send_all(fd, "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            break;
+        }
+        request.method = message.start.substr(0, space);
+        request.path = message.start.substr(space + 1, second - space - 1);
+        request.body = std::move(message.body);
+
+        Response response;
+        try {
+            response = handler(request);
+        } catch (const std::exception&) {
+            response = {500, ""};
+        }
+
+        bool close_after = lowercase(message.headers["connection"]) == "close" ||
+                           message.start.compare(second + 1, std::string::npos, "HTTP/1.0") == 0;
+
+        std::string reply = "HTTP/1.1 " + std::to_string(response.status) + " " +
+                            reason(response.status) + "\r\n" +
+                            "Content-Length: " + std::to_string(response.body.size()) + "\r\n" +
+                            (close_after ? "Connection: close\r\n" : "") + "\r\n";
+        if (request.method != "HEAD") {
+            reply += response.body;
+        }
+        if (!send_all(fd, reply) || close_after) {
+            break;
+        }
+    }
+    close(fd);
+}
+
+#endif
+
+} // namespace
+
+Url parse_url(const std::string& text) {
+    const std::string scheme = "http://";
+    if (text.compare(0, scheme.size(), scheme) != 0) {
+        throw std::runtime_error("Only http:// urls are supported: " + text);
+    }
+
+    Url url;
+    std::string rest = text.substr(scheme.size());
+    size_t slash = rest.find('/');
+    std::string authority = rest.substr(0, slash);
+    if (slash != std::string::npos) {
+        url.prefix = rest.substr(slash);
+        while (!url.prefix.empty() && url.prefix.back() == '/') url.prefix.pop_back();
+    }
+
+    // [v6 address]:port
+    size_t colon = authority.rfind(':');
+    size_t bracket = authority.rfind(']');
+    if (colon != std::string::npos && (bracket == std::string::npos || colon > bracket)) {
+        url.port = authority.substr(colon + 1);
+        authority.erase(colon);
+    }
+    if (authority.size() > 1 && authority.front() == '[' && authority.back() == ']') {
+        authority = authority.substr(1, authority.size() - 2);
+    }
+    url.host = authority;
+
+    if (url.host.empty() || url.port.empty() ||
+        url.port.find_first_not_of("0123456789") != std::string::npos) {
+        throw std::runtime_error("Invalid url: " + text);
+    }
+    return url;
+}
+
+#ifndef _WIN32
+
+Client::Client(const std::string& url, int timeout_ms)
+    : m_url(parse_url(url)), m_timeout_ms(timeout_ms) {}
+
+Client::~Client() {
+    for (int fd : m_idle) {
+        close(fd);
+    }
+}
+
+int Client::connect() {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = nullptr;
+    if (getaddrinfo(m_url.host.c_str(), m_url.port.c_str(), &hints, &found) != 0) {
+        throw std::runtime_error("Cannot resolve " + m_url.host);
+    }
+
+    int fd = -1;
+    for (addrinfo* addr = found; addr; addr = addr->ai_next) {
+        fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+        if (fd < 0) continue;
+        // on linux the send timeout also bounds connect
+        set_timeouts(fd, m_timeout_ms);
+        if (::connect(fd, addr->ai_addr, addr->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(found);
+
+    if (fd < 0) {
+        throw std::runtime_error("Cannot connect to " + m_url.host + ":" + m_url.port);
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
+
+Response Client::request(const std::string& method, const std::string& path,
+                         const std::string& body) {
+    std::string message = method + " " + m_url.prefix + path + " HTTP/1.1\r\n" +
+                          "Host: " + m_url.host + ":" + m_url.port + "\r\n";
+    if (method == "PUT" || method == "POST" || !body.empty()) {
+        message += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    }
+    message += "\r\n" + body;
+
+    // a pooled connection may have been closed by the server in the
+    // meantime, only a fresh one failing is an error
+    for (;;) {
+        int fd = -1;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_idle.empty()) {
+                fd = m_idle.back();
+                m_idle.pop_back();
+            }
+        }
+        bool reused = fd >= 0;
+        if (!reused) {
+            fd = connect();
+        }
+
+        Stream stream(fd);
+        Message reply;
+        if (!send_all(fd, message) || !read_message(stream, reply, method != "HEAD", true)) {
+            close(fd);
+            if (reused) continue;
+            throw std::runtime_error("Connection to " + m_url.host + ":" + m_url.port + " failed");
+        }
+
+        Response response;
+        size_t space = reply.start.find(' ');
+        response.status = space == std::string::npos ? 0 : std::atoi(reply.start.c_str() + space + 1);
+        response.body = std::move(reply.body);
+
+        bool keep = !stream.closed && stream.buffer.empty() &&
+                    lowercase(reply.headers["connection"]) != "close";
+        if (keep) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_idle.push_back(fd);
+        } else {
+            close(fd);
+        }
+        return response;
+    }
+}
+
+Server::Server(const std::string& bind, const std::string& port) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* found = nullptr;
+    if (getaddrinfo(bind.empty() ? nullptr : bind.c_str(), port.c_str(), &hints, &found) != 0) {
+        throw std::runtime_error("Cannot resolve " + bind);
+    }
+
+    for (addrinfo* addr = found; addr; addr = addr->ai_next) {
+        m_fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+        if (m_fd < 0) continue;
+        int on = 1;
+        setsockopt(m_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (::bind(m_fd, addr->ai_addr, addr->ai_addrlen) == 0 && listen(m_fd, 128) == 0) break;
+        close(m_fd);
+        m_fd = -1;
+    }
+    freeaddrinfo(found);
+
+    if (m_fd < 0) {
+        throw std::runtime_error("Cannot listen on " + bind + ":" + port + ": " + std::strerror(errno));
+    }
+
+    sockaddr_storage local{};
+    socklen_t length = sizeof(local);
+    if (getsockname(m_fd, reinterpret_cast<sockaddr*>(&local), &length) == 0) {
+        m_port = ntohs(local.ss_family == AF_INET6
+            ? reinterpret_cast<sockaddr_in6*>(&local)->sin6_port
+            : reinterpret_cast<sockaddr_in*>(&local)->sin_port);
+    }
+}
+
+Server::~Server() {
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+void Server::serve(const Handler& handler) {
+    for (;;) {
+        int fd = accept(m_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            throw std::runtime_error(std::string("accept: ") + std::strerror(errno));
+        }
+        std::thread(serve_connection, fd, handler).detach();
+    }
+}
+
+#else
+
+Client::Client(const std::string& url, int timeout_ms) : m_url(parse_url(url)), m_timeout_ms(timeout_ms) {
+    throw std::runtime_error("The remote cache is not supported on Windows yet");
+}
+
+Client::~Client() = default;
+
+int Client::connect() {
+    return -1;
+}
+
+Response Client::request(const std::string&, const std::string&, const std::string&) {
+    return {};
+}
+
+Server::Server(const std::string&, const std::string&) {
+    throw std::runtime_error("iris cache serve is not supported on Windows yet");
+}
+
+Server::~Server() = default;
+
+void Server::serve(const Handler&) {}
+
+#endif
+
+} // namespace iris::util::http
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <functional>
+
+namespace iris::util::http {
+
+// minimal http/1.1 over plain tcp, enough for a build cache server. there
+// is no tls, put a proxy in front of the server for that
+
+struct Url {
+    std::string host;
+    std::string port = "80";
+    std::string prefix;   // path below the root, without a trailing slash
+};
+
+// "http://host[:port][/prefix]", throws std::runtime_error on anything else
+Url parse_url(const std::string& text);
+
+struct Response {
+    int status = 0;
+    std::string body;
+};
+
+// keeps idle connections open and hands them to the next request, so
+// concurrent callers on a build's worth of small objects don't pay a tcp
+// handshake each. safe to share between threads
+class Client {
+public:
+    explicit Client(const std::string& url, int timeout_ms = 10000);
+    ~Client();
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    // path is appended to the url's prefix. throws std::runtime_error when
+    // the server cannot be reached, http errors come back as the status
+    Response request(const std::string& method, const std::string& path,
+                     const std::string& body = "");
+
+    Response get(const std::string& path) { return request("GET", path); }
+    Response head(const std::string& path) { return request("HEAD", path); }
+    Response put(const std::string& path, const std::string& body) {
+        return request("PUT", path, body);
+    }
+
+private:
+    Url m_url;
+    int m_timeout_ms;
+    std::mutex m_mutex;
+    std::vector<int> m_idle;
+
+    int connect();
+};
+
+struct Request {
+    std::string method;
+    std::string path;
+    std::string body;
+};
+
+using Handler = std::function<Response(const Request&)>;
+
+// serves requests with a thread per connection until the process exits.
+// bind and port are as for parse_url, port "0" picks a free one
+class Server {
+public:
+    Server(const std::string& bind, const std::string& port);
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    int port() const { return m_port; }
+    void serve(const Handler& handler);
+
+private:
+    int m_fd = -1;
+    int m_port = 0;
+};
+
+} // namespace iris::util::http
@@ -0,0 +1,226 @@
+#include "json.hpp"
+
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdio>
+
+namespace iris::util::json {
+
+static const Value s_null;
+
+const Value& Value::operator[](const std::string& key) const {
+    for (const auto& [name, value] : object) {
+        if (name == key) return value;
+    }
+    return s_null;
+}
+
+const Value& Value::operator[](size_t index) const {
+    if (index < array.size()) return array[index];
+    return s_null;
+}
+
+size_t Value::size() const {
+    if (is_array()) return array.size();
+    if (is_object()) return object.size();
+    return 0;
+}
+
+std::string Value::as_string() const {
+    if (type == Type::String) return string;
+    if (type == Type::Number) {
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), "%.17g", number);
+        return buffer;
+    }
+    if (type == Type::Bool) return boolean ? "true" : "false";
+    return "";
+}
+
+double Value::as_number() const {
+    if (type == Type::Number) return number;
+    if (type == Type::String) return std::strtod(string.c_str(), nullptr);
+    if (type == Type::Bool) return boolean ? 1.0 : 0.0;
+    return 0.0;
+}
+
+bool Value::as_bool() const {
+    if (type == Type::Bool) return boolean;
+    if (type == Type::Number) return number != 0.0;
+    return false;
+}
+
+namespace {
+
+class Reader {
+public:
+    explicit Reader(const std::string& text) : m_text(text) {}
+
+    Value read_document() {
+        Value value = read_value();
+        skip_whitespace();
+        if (m_pos != m_text.size()) {
+            fail("trailing characters");
+        }
+        return value;
+    }
+
+private:
+    const std::string& m_text;
+    size_t m_pos = 0;
+
+    [[noreturn]] void fail(const std::string& message) const {
+        throw std::runtime_error("json: " + message + " at offset " + std::to_string(m_pos));
+    }
+
+    void skip_whitespace() {
+        while (m_pos < m_text.size() &&
+               (m_text[m_pos] == ' ' || m_text[m_pos] == '\t' ||
+                m_text[m_pos] == '\n' || m_text[m_pos] == '\r')) {
+            m_pos++;
+        }
+    }
+
+    bool consume(const std::string& literal) {
+        if (m_text.compare(m_pos, literal.size(), literal) == 0) {
+            m_pos += literal.size();
+            return true;
+        }
+        return false;
+    }
+
+    Value read_value() {
+        skip_whitespace();
+        if (m_pos >= m_text.size()) fail("unexpected end of input");
+
+        Value value;
+        char c = m_text[m_pos];
+
+        if (c == '{') {
+            value.type = Value::Type::Object;
+            m_pos++;
+            skip_whitespace();
+            if (consume("}")) return value;
+            while (true) {
+                skip_whitespace();
+                if (m_pos >= m_text.size() || m_text[m_pos] != '"') fail("expected object key");
+                std::string key = read_string();
+                skip_whitespace();
+                if (!consume(":")) fail("expected ':'");
+                value.object.emplace_back(key, read_value());
+                skip_whitespace();
+                if (consume("}")) break;
+                if (!consume(",")) fail("expected ',' or '}'");
+            }
+        } else if (c == '[') {
+            value.type = Value::Type::Array;
+            m_pos++;
+            skip_whitespace();
+            if (consume("]")) return value;
+            while (true) {
+                value.array.push_back(read_value());
+                skip_whitespace();
+                if (consume("]")) break;
+                if (!consume(",")) fail("expected ',' or ']'");
+            }
+        } else if (c == '"') {
+            value.type = Value::Type::String;
+            value.string = read_string();
+        } else if (consume("true")) {
+            value.type = Value::Type::Bool;
+            value.boolean = true;
+        } else if (consume("false")) {
+            value.type = Value::Type::Bool;
+        } else if (consume("null")) {
+            value.type = Value::Type::Null;
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            const char* start = m_text.c_str() + m_pos;
+            char* end = nullptr;
+            value.type = Value::Type::Number;
+            value.number = std::strtod(start, &end);
+            m_pos += static_cast<size_t>(end - start);
+        } else {
+            fail(std::string("unexpected character '") + c + "'");
+        }
+
+        return value;
+    }
+
+    std::string read_string() {
+        std::string result;
+        m_pos++;  // opening quote
+
+        while (m_pos < m_text.size() && m_text[m_pos] != '"') {
+            char c = m_text[m_pos++];
+            if (c != '\\') {
+                result += c;
+                continue;
+            }
+            if (m_pos >= m_text.size()) break;
+
+            char esc = m_text[m_pos++];
+            switch (esc) {
+                case 'n': result += '\n'; break;
+                case 't': result += '\t'; break;
+                case 'r': result += '\r'; break;
+                case 'b': result += '\b'; break;
+                case 'f': result += '\f'; break;
+                case 'u': {
+                    if (m_pos + 4 > m_text.size()) fail("bad unicode escape");
+                    unsigned long code = std::strtoul(m_text.substr(m_pos, 4).c_str(), nullptr, 16);
+                    m_pos += 4;
+                    // encode as utf-8, surrogate pairs are kept as-is
+                    if (code < 0x80) {
+                        result += static_cast<char>(code);
+                    } else if (code < 0x800) {
+                        result += static_cast<char>(0xC0 | (code >> 6));
+                        result += static_cast<char>(0x80 | (code & 0x3F));
+                    } else {
+                        result += static_cast<char>(0xE0 | (code >> 12));
+                        result += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                        result += static_cast<char>(0x80 | (code & 0x3F));
+                    }
+                    break;
+                }
+                default: result += esc; break;
+            }
+        }
+
+        if (m_pos >= m_text.size()) fail("unterminated string");
+        m_pos++;  // closing quote
+        return result;
+    }
+};
+
+} // namespace
+
+Value parse(const std::string& text) {
+    return Reader(text).read_document();
+}
+
+std::string escape(const std::string& text) {
+    std::string result;
+    result.reserve(text.size());
+
+    for (char c : text) {
+        switch (c) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\t': result += "\\t"; break;
+            case '\r': result += "\\r"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buffer[8];
+                    std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    result += buffer;
+                } else {
+                    result += c;
+                }
+        }
+    }
+
+    return result;
+}
+
+} // namespace iris::util::json
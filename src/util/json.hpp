@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace iris::util::json {
+
+// minimal json document model, enough for the files iris reads back
+struct Value {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<Value> array;
+    std::vector<std::pair<std::string, Value>> object;
+
+    bool is_null() const { return type == Type::Null; }
+    bool is_array() const { return type == Type::Array; }
+    bool is_object() const { return type == Type::Object; }
+
+    // missing keys and out of range indices yield a null value
+    const Value& operator[](const std::string& key) const;
+    const Value& operator[](size_t index) const;
+    size_t size() const;
+
+    std::string as_string() const;
+    double as_number() const;
+    bool as_bool() const;
+};
+
+// throws std::runtime_error on malformed input
+Value parse(const std::string& text);
+
+// escape a string for embedding between double quotes
+std::string escape(const std::string& text);
+
+} // namespace iris::util::json
@@ -0,0 +1,222 @@
+#include "tokens.hpp"
+#include "hash.hpp"
+
+#include <cctype>
+#include <cstdint>
+#include <vector>
+
+namespace iris::util::tokens {
+
+namespace {
+
+struct Token {
+    std::string text;  // " " and "\n" mark separation and the end of a directive
+    uint32_t line;
+};
+
+bool is_ident(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$' ||
+           static_cast<unsigned char>(c) >= 0x80;
+}
+
+bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+class Scanner {
+public:
+    explicit Scanner(const std::string& text) {
+        // line splices go first, they may sit anywhere, even inside a token
+        m_code.reserve(text.size());
+        m_lines.reserve(text.size());
+        uint32_t line = 1;
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] == '\\') {
+                size_t next = i + 1;
+                if (next < text.size() && text[next] == '\r') next++;
+                if (next < text.size() && text[next] == '\n') {
+                    line++;
+                    i = next;
+                    continue;
+                }
+            }
+            m_code += text[i];
+            m_lines.push_back(line);
+            if (text[i] == '\n') line++;
+        }
+    }
+
+    std::vector<Token> scan() {
+        std::vector<Token> tokens;
+        bool directive = false;
+        bool line_start = true;
+        bool space = false;
+
+        auto emit = [&](size_t begin, size_t end) {
+            if (directive && space) tokens.push_back({" ", m_lines[begin]});
+            tokens.push_back({m_code.substr(begin, end - begin), m_lines[begin]});
+            space = false;
+            line_start = false;
+        };
+
+        size_t i = 0;
+        while (i < m_code.size()) {
+            char c = m_code[i];
+
+            if (c == '\n') {
+                if (directive) tokens.push_back({"\n", m_lines[i]});
+                directive = false;
+                line_start = true;
+                space = false;
+                i++;
+            } else if (is_space(c)) {
+                space = true;
+                i++;
+            } else if (c == '/' && peek(i + 1) == '/') {
+                while (i < m_code.size() && m_code[i] != '\n') i++;
+            } else if (c == '/' && peek(i + 1) == '*') {
+                size_t end = m_code.find("*/", i + 2);
+                i = end == std::string::npos ? m_code.size() : end + 2;
+                space = true;
+            } else if (c == '#' && line_start) {
+                directive = true;
+                emit(i, i + 1);
+                i++;
+            } else if (c == '"' || c == '\'') {
+                size_t end = quoted(i);
+                emit(i, end);
+                i = end;
+            } else if (std::isdigit(static_cast<unsigned char>(c)) ||
+                       (c == '.' && std::isdigit(static_cast<unsigned char>(peek(i + 1))))) {
+                size_t end = number(i);
+                emit(i, end);
+                i = end;
+            } else if (is_ident(c)) {
+                size_t end = i;
+                while (end < m_code.size() && is_ident(m_code[end])) end++;
+                // encoding prefixes and raw strings belong to their literal
+                std::string prefix = m_code.substr(i, end - i);
+                if (peek(end) == '"' &&
+                    (prefix == "R" || prefix == "LR" || prefix == "uR" || prefix == "UR" || prefix == "u8R")) {
+                    end = raw(end);
+                } else if ((peek(end) == '"' || peek(end) == '\'') &&
+                           (prefix == "L" || prefix == "u" || prefix == "U" || prefix == "u8")) {
+                    end = quoted(end);
+                }
+                emit(i, end);
+                i = end;
+            } else {
+                // runs of punctuation stay together, "a+ +b" is not "a++b"
+                size_t end = i;
+                while (end < m_code.size() && !is_space(m_code[end]) && m_code[end] != '\n' &&
+                       !is_ident(m_code[end]) && m_code[end] != '"' && m_code[end] != '\'' &&
+                       !(m_code[end] == '/' && (peek(end + 1) == '/' || peek(end + 1) == '*'))) {
+                    end++;
+                }
+                if (end == i) end++;
+                emit(i, end);
+                i = end;
+            }
+        }
+        return tokens;
+    }
+
+private:
+    std::string m_code;
+    std::vector<uint32_t> m_lines;
+
+    char peek(size_t i) const {
+        return i < m_code.size() ? m_code[i] : '\0';
+    }
+
+    // end of a string or character literal starting at its quote. an
+    // unterminated one ends with its line
+    size_t quoted(size_t i) const {
+        char quote = m_code[i];
+        for (i++; i < m_code.size() && m_code[i] != '\n'; i++) {
+            if (m_code[i] == '\\') {
+                i++;
+            } else if (m_code[i] == quote) {
+                return i + 1;
+            }
+        }
+        return i;
+    }
+
+    // end of R"delim(...)delim" starting at its quote
+    size_t raw(size_t i) const {
+        size_t open = m_code.find('(', i);
+        if (open == std::string::npos) return quoted(i);
+        std::string close = ")" + m_code.substr(i + 1, open - i - 1) + "\"";
+        size_t end = m_code.find(close, open);
+        return end == std::string::npos ? m_code.size() : end + close.size();
+    }
+
+    // end of a pp-number, exponent signs and digit separators included
+    size_t number(size_t i) const {
+        i++;
+        while (i < m_code.size()) {
+            char c = m_code[i];
+            if ((c == '+' || c == '-') && std::string("eEpP").find(m_code[i - 1]) != std::string::npos) {
+                i++;
+            } else if (c == '\'' && is_ident(peek(i + 1))) {
+                i += 2;
+            } else if (is_ident(c) || c == '.') {
+                i++;
+            } else {
+                break;
+            }
+        }
+        return i;
+    }
+};
+
+} // namespace
+
+Hashes stream_hashes(const std::string& text) {
+    std::vector<Token> tokens = Scanner(text).scan();
+
+    // the line may come out of a macro defined elsewhere, assert's sits in a
+    // system header no depfile lists
+    Hashes hashes;
+    for (const auto& token : tokens) {
+        if (token.text == "__LINE__" || token.text == "__builtin_LINE" ||
+            token.text == "source_location" || token.text == "assert") {
+            hashes.line_macro = true;
+            break;
+        }
+    }
+
+    std::string plain;
+    std::string lines;
+    plain.reserve(text.size());
+    lines.reserve(text.size() + text.size() / 8);
+    uint32_t line = 0;
+    for (const auto& token : tokens) {
+        if (token.line != line) {
+            lines += "\x1e" + std::to_string(token.line);
+            line = token.line;
+        }
+        plain += token.text;
+        plain += '\x1f';
+        lines += token.text;
+        lines += '\x1f';
+    }
+    hashes.plain = hash::sha256(plain);
+    hashes.lines = hash::sha256(lines);
+    return hashes;
+}
+
+std::set<std::string> identifiers(const std::string& text) {
+    std::set<std::string> result;
+    for (auto& token : Scanner(text).scan()) {
+        char first = token.text[0];
+        if (is_ident(first) && !std::isdigit(static_cast<unsigned char>(first)) &&
+            token.text.find_first_of("\"'") == std::string::npos) {
+            result.insert(std::move(token.text));
+        }
+    }
+    return result;
+}
+
+} // namespace iris::util::tokens
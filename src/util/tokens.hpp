@@ -0,0 +1,25 @@
+#pragma once
+
+#include <set>
+#include <string>
+
+namespace iris::util::tokens {
+
+// hashes of the token stream of c or c++ source. comments, line splices and
+// whitespace between tokens do not count, so edits to them keep the hashes.
+// preprocessor lines still end where they end and keep whether tokens were
+// separated ("F(x)" is not "F (x)" after #define). lines also counts the
+// line each token starts on
+struct Hashes {
+    std::string plain;
+    std::string lines;
+    bool line_macro = false;  // names __LINE__, __builtin_LINE, source_location or assert
+};
+
+Hashes stream_hashes(const std::string& text);
+
+// identifiers and keywords of c or c++ source, those in directives included.
+// literals and comments do not count
+std::set<std::string> identifiers(const std::string& text);
+
+} // namespace iris::util::tokens
@@ -0,0 +1,123 @@
+// 64 processes store into and restore from one cache at the same time. every
+// store must end up as an entry and every restore as a hit, across the
+// compactions the journal goes through on the way
+
+#include "core/cache.hpp"
+#include "util/fs.hpp"
+#include "util/hash.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int WRITERS = 64;
+constexpr int ROUNDS = 200;
+
+std::string key_of(int writer, int round) {
+    return iris::util::hash::sha256("cache-stress " + std::to_string(writer) + " " + std::to_string(round));
+}
+
+// stores and restores ROUNDS entries of its own, returns the failures
+int write(const std::string& cache_dir, const std::string& scratch, int writer) {
+    iris::core::Cache cache(cache_dir);
+    std::string base = scratch + "/" + std::to_string(writer);
+    int failures = 0;
+
+    for (int round = 0; round < ROUNDS; round++) {
+        std::string content = "writer " + std::to_string(writer) + " round " + std::to_string(round) + "\n";
+        iris::util::fs::write_file(base + ".in", content);
+        cache.store(key_of(writer, round), base + ".o", {{"object", base + ".in"}});
+
+        iris::util::fs::remove_file(base + ".out");
+        if (!cache.restore(key_of(writer, round), {{"object", base + ".out"}}) ||
+            iris::util::fs::read_file(base + ".out") != content) {
+            failures++;
+        }
+    }
+    return failures;
+}
+
+bool check(const std::string& cache_dir, const char* when) {
+    iris::core::Cache cache(cache_dir);
+    cache.load();
+    auto stats = cache.stats();
+    uint64_t expected = static_cast<uint64_t>(WRITERS) * ROUNDS;
+
+    std::cout << when << ": " << stats.entries << " entries, " << stats.hits << " hits, "
+              << stats.misses << " misses\n";
+    bool ok = stats.entries == expected && stats.hits == expected && stats.misses == 0;
+    for (int writer = 0; ok && writer < WRITERS; writer++) {
+        for (int round = 0; round < ROUNDS; round++) {
+            if (!cache.get(key_of(writer, round))) {
+                std::cout << "missing entry of writer " << writer << " round " << round << "\n";
+                ok = false;
+                break;
+            }
+        }
+    }
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    // limits from the environment would evict entries under test
+    unsetenv("IRIS_CACHE_MAX_SIZE");
+    unsetenv("IRIS_CACHE_MAX_AGE");
+
+    char templ[] = "/tmp/iris-cache-stress-XXXXXX";
+    std::string root = argc > 1 ? argv[1] : "";
+    if (root.empty()) {
+        if (!mkdtemp(templ)) {
+            std::perror("mkdtemp");
+            return 1;
+        }
+        root = templ;
+    }
+    std::string cache_dir = root + "/cache";
+    std::string scratch = root + "/scratch";
+    iris::util::fs::create_directories(scratch);
+
+    std::vector<pid_t> children;
+    for (int writer = 0; writer < WRITERS; writer++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::perror("fork");
+            return 1;
+        }
+        if (pid == 0) {
+            int failures = write(cache_dir, scratch, writer);
+            _exit(failures == 0 ? 0 : 1);
+        }
+        children.push_back(pid);
+    }
+
+    int failed = 0;
+    for (pid_t pid : children) {
+        int status = 0;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+    }
+    if (failed > 0) {
+        std::cout << failed << " of " << WRITERS << " writers failed to restore their entries\n";
+    }
+
+    bool ok = failed == 0 && check(cache_dir, "after the writers");
+    if (ok) {
+        iris::core::Cache cache(cache_dir);
+        cache.compact();
+        ok = check(cache_dir, "after compaction");
+    }
+
+    if (argc <= 1) iris::util::fs::remove_all(root);
+    std::cout << (ok ? "ok" : "FAILED") << "\n";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+#!/bin/sh
+# an object library under a library that --dev-shared makes shared must be
+# linked once, into that library. executables and tests that link the
+# library would otherwise run its static initializers a second time
+#
+# usage: dev_shared_objects.sh <iris>
+
+set -eu
+
+IRIS=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+ROOT=$(mktemp -d /tmp/iris-dev-shared-XXXXXX)
+trap 'rm -rf "$ROOT"' EXIT
+
+mkdir -p "$ROOT/src" "$ROOT/tests"
+cat > "$ROOT/src/registry.cpp" <<'EOF'
+#include <cstdio>
+int registered = 0;
+static int init = [] { std::puts("reg init"); return ++registered; }();
+EOF
+cat > "$ROOT/src/core.cpp" <<'EOF'
+extern int registered;
+int core_registered() { return registered; }
+EOF
+cat > "$ROOT/src/main.cpp" <<'EOF'
+int core_registered();
+int main() { return core_registered() == 1 ? 0 : 1; }
+EOF
+cp "$ROOT/src/main.cpp" "$ROOT/tests/t1.cpp"
+cat > "$ROOT/iris.build" <<'EOF'
+project "devshared" do
+    version = "0.1.0"
+    lang = :cpp
+    std = "c++17"
+end
+
+object_library "registry" do
+    sources = ["src/registry.cpp"]
+end
+
+library "core" do
+    sources = ["src/core.cpp"]
+    deps = ["registry"]
+end
+
+executable "app" do
+    sources = ["src/main.cpp"]
+    deps = ["core"]
+end
+
+test "t1" do
+    sources = ["tests/t1.cpp"]
+    deps = ["core"]
+end
+EOF
+
+backend=make
+command -v ninja >/dev/null 2>&1 && backend=ninja
+
+cd "$ROOT"
+"$IRIS" setup --dev-shared --backend=$backend >/dev/null
+"$IRIS" build >/dev/null
+
+status=0
+for binary in build/app build/tests/t1; do
+    count=$(cd build && "./${binary#build/}" | grep -c "reg init" || true)
+    if [ "$count" != 1 ]; then
+        echo "$binary ran the registry's initializer $count times, expected 1"
+        status=1
+    fi
+done
+[ $status = 0 ] && echo "ok"
+exit $status